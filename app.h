@@ -53,6 +53,12 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include "print_lcd.h"
 #include "uart.h"
 #include "spi.h"
+#include "eeprom.h"
+#include "rtcc.h"
+#include "timestamp.h"
+#include "trace.h"
+#include "adc.h"
+#include "format.h"
 
 // *****************************************************************************
 // *****************************************************************************
@@ -74,28 +80,23 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 
 typedef struct
 {
-    /* Variables used by Timer module */
-    volatile unsigned char hours ;
-    volatile unsigned char minutes ;
-    volatile unsigned char seconds ;
-    volatile unsigned char hunds ;
-    volatile unsigned char tens ;
-    volatile unsigned char ones ;
-    volatile unsigned char rtc_lcd_update ;
-    
-    /* variables used in raw ADC data to hex */
-    volatile unsigned char adones ;
-    volatile unsigned char adtens ;
-    volatile unsigned char adhunds ;
-    volatile unsigned char adthous ;
-    volatile unsigned int  temp1 ;
-    volatile unsigned char adc_lcd_update ;
-
-    /*arrays used for Explorer 16 LCD display*/
-    char messageLine1[18] ;
-    char messageLine2[18]  ;
-    char messageTime[18] ;
-    char messageADC[18] ;
+    /* Event flags.  Each flag is a single bit of one volatile word so the
+       compiler sets and clears it with BSET/BCLR, which cannot be torn by an
+       interrupt that updates a neighbouring flag */
+    volatile struct
+    {
+        unsigned rtc_lcd_update : 1 ;
+        unsigned adc_lcd_update : 1 ;
+        unsigned lcd_hold : 1 ;         /* LCD lent to another display */
+        unsigned lcd_ready : 1 ;        /* background LCD setup finished */
+        unsigned : 12 ;
+    } flags ;
+
+    /* Latest raw ADC readings (potentiometer and TC1047A).  Values are held
+       once in binary and only converted to text when the display is
+       redrawn; the time of day is kept by the RTCC (see BSP_RTCC_TimeGet) */
+    volatile uint16_t adcCounts ;
+    volatile uint16_t temperatureCounts ;
 
 } APP_DATA ;
 
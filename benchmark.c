@@ -0,0 +1,435 @@
+/*******************************************************************************
+ Explorer 16 Demo UART Benchmark File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    benchmark.c
+
+  Summary:
+    UART1 loopback throughput and latency benchmark
+
+  Description:
+    Each rate is measured in two passes. The throughput pass keeps a window
+    of bytes in flight through the transmit queue, the loopback and the
+    receive queue, timing the whole transfer with the Timer 4/5 timestamp
+    and the UART interrupts with the driver's profiling counters. The
+    latency pass then sends single bytes on an idle line.
+ *******************************************************************************/
+
+// DOM-IGNORE-BEGIN
+/*******************************************************************************
+Copyright (c) 2013 released Microchip Technology Inc.  All rights reserved.
+
+Microchip licenses to you the right to use, modify, copy and distribute
+Software only when embedded on a Microchip microcontroller or digital signal
+controller that is integrated into your product or third party product
+(pursuant to the sublicense terms in the accompanying license agreement).
+
+You should refer to the license agreement accompanying this Software for
+additional information regarding your rights and obligations.
+
+SOFTWARE AND DOCUMENTATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY WARRANTY OF
+MERCHANTABILITY, TITLE, NON-INFRINGEMENT AND FITNESS FOR A PARTICULAR PURPOSE.
+IN NO EVENT SHALL MICROCHIP OR ITS LICENSORS BE LIABLE OR OBLIGATED UNDER
+CONTRACT, NEGLIGENCE, STRICT LIABILITY, CONTRIBUTION, BREACH OF WARRANTY, OR
+OTHER LEGAL EQUITABLE THEORY ANY DIRECT OR INDIRECT DAMAGES OR EXPENSES
+INCLUDING BUT NOT LIMITED TO ANY INCIDENTAL, SPECIAL, INDIRECT, PUNITIVE OR
+CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, COST OF PROCUREMENT OF
+SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
+(INCLUDING BUT NOT LIMITED TO ANY DEFENSE THEREOF), OR OTHER SIMILAR COSTS.
+ *******************************************************************************/
+// DOM-IGNORE-END
+
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <string.h>
+#include <system.h>
+
+#include "app.h"
+#include "benchmark.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: File Scope Variables and Functions
+// *****************************************************************************
+// *****************************************************************************
+
+/* Bytes in flight, half the receive queue so it can never overflow */
+#define BENCH_WINDOW            16
+
+#define BENCH_PINGS             8
+#define BENCH_LCD_COLUMNS       16
+#define BENCH_LCD_HOLD_MS       10000
+
+/* A byte is declared lost after 20 character times (10 bits each) plus
+   2 ms of slack for the main loop */
+#define BENCH_TIMEOUT_CHARACTERS    20
+#define BENCH_TIMEOUT_SLACK_TICKS   (2000UL * TIME_TICKS_PER_MICRO_SECOND)
+
+static const uint32_t benchRates[BENCH_RATE_COUNT] =
+{
+    9600, 19200, 38400, 57600, 115200
+};
+
+static BENCH_RESULT benchResults[BENCH_RATE_COUNT];
+
+static void BENCH_Measure(uint32_t baud, uint16_t payloadBytes, BENCH_RESULT *result);
+static void BENCH_Latency(uint32_t timeoutTicks, BENCH_RESULT *result);
+static void BENCH_Report(uint16_t payloadBytes);
+static void BENCH_Display(void);
+static void BENCH_LcdRow(char *row);
+static void BENCH_LcdRelease(void);
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+/*******************************************************************************
+
+  Function:
+   bool BENCH_Run( uint16_t payloadBytes )
+
+  Summary:
+    Runs the loopback benchmark at every rate and reports the results
+
+ */
+bool BENCH_Run(uint16_t payloadBytes)
+{
+    PRINT_CONFIGURATION previous;
+    uint32_t savedBaud;
+    uint8_t i;
+
+    if((payloadBytes == 0) || (payloadBytes > BENCH_MAX_PAYLOAD))
+    {
+        return false;
+    }
+
+    savedBaud = UART_GetBaud();
+
+    // Waits for pending console output, nothing reaches the pins after this
+    UART_LoopbackEnable(true);
+
+    for(i = 0; i < BENCH_RATE_COUNT; i++)
+    {
+        BENCH_Measure(benchRates[i], payloadBytes, &benchResults[i]);
+    }
+
+    UART_SetBaud(savedBaud);
+    UART_LoopbackEnable(false);
+
+    previous = PRINT_GetConfiguration();
+    BENCH_Report(payloadBytes);
+    BENCH_Display();
+    PRINT_SetConfiguration(previous);
+
+    return true;
+}
+
+/*******************************************************************************
+
+  Function:
+   const BENCH_RESULT *BENCH_ResultsGet( void )
+
+  Summary:
+    Returns the BENCH_RATE_COUNT results of the last run
+
+ */
+const BENCH_RESULT *BENCH_ResultsGet(void)
+{
+    return benchResults;
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Local Functions
+// *****************************************************************************
+// *****************************************************************************
+
+/*******************************************************************************
+
+  Function:
+   static void BENCH_Measure( uint32_t baud, uint16_t payloadBytes,
+                              BENCH_RESULT *result )
+
+  Summary:
+    Measures one rate
+
+  Description:
+    The driver call cycles are timed around each successful UART_PutChar()
+    and UART_GetChar() and added to the interrupt cycles, so cyclesPerByte
+    is the full CPU cost of moving one byte out and back in. The timestamp
+    reads themselves add a few cycles to both.
+
+ */
+static void BENCH_Measure(uint32_t baud, uint16_t payloadBytes, BENCH_RESULT *result)
+{
+    UART_STATISTICS before;
+    UART_STATISTICS after;
+    uint32_t timeout;
+    uint32_t start;
+    uint32_t lastProgress;
+    uint32_t elapsed;
+    uint32_t callTicks = 0;
+    uint32_t timestamp;
+    uint16_t sent = 0;
+    uint16_t received = 0;
+    uint8_t data;
+
+    memset(result, 0, sizeof(*result));
+
+    result->baud = UART_SetBaud(baud);
+    if(result->baud == 0)
+    {
+        result->errors = payloadBytes;
+        return;
+    }
+
+    timeout = ((SYSTEM_PERIPHERAL_CLOCK * 10 * BENCH_TIMEOUT_CHARACTERS) / result->baud) +
+              BENCH_TIMEOUT_SLACK_TICKS;
+
+    while(UART_GetChar(&data))
+    {
+        // discard anything left from the previous rate
+    }
+
+    UART_StatisticsGet(&before);
+    UART_ProfileEnable(true);
+
+    start = TIME_NowTicks();
+    lastProgress = start;
+
+    while(received < payloadBytes)
+    {
+        if((sent < payloadBytes) && ((uint16_t)(sent - received) < BENCH_WINDOW))
+        {
+            timestamp = TIME_NowTicks();
+            UART_PutChar((uint8_t)sent);
+            callTicks += TIME_ElapsedTicks(timestamp);
+            sent++;
+        }
+
+        timestamp = TIME_NowTicks();
+        if(UART_GetChar(&data))
+        {
+            callTicks += TIME_ElapsedTicks(timestamp);
+
+            if(data != (uint8_t)received)
+            {
+                result->errors++;
+            }
+            received++;
+            lastProgress = TIME_NowTicks();
+        }
+        else if(TIME_ElapsedTicks(lastProgress) > timeout)
+        {
+            result->errors += payloadBytes - received;
+            break;
+        }
+    }
+
+    elapsed = TIME_ElapsedTicks(start);
+
+    UART_ProfileEnable(false);
+    UART_StatisticsGet(&after);
+
+    if((received != 0) && (elapsed != 0))
+    {
+        result->bytesPerSecond = ((uint32_t)received * 1000000UL) / TIME_TicksToMicroseconds(elapsed);
+        result->cyclesPerByte = (uint16_t)((after.isrTicks - before.isrTicks + callTicks) / received);
+    }
+    result->txInterrupts = (uint16_t)(after.txInterrupts - before.txInterrupts);
+    result->rxInterrupts = (uint16_t)(after.rxInterrupts - before.rxInterrupts);
+
+    BENCH_Latency(timeout, result);
+}
+
+/*******************************************************************************
+
+  Function:
+   static void BENCH_Latency( uint32_t timeoutTicks, BENCH_RESULT *result )
+
+  Summary:
+    Times single bytes from UART_PutChar() until UART_GetChar() returns them
+
+  Description:
+    On an idle line this is one character time plus the transmit path, the
+    receive interrupt and the main loop poll.
+
+ */
+static void BENCH_Latency(uint32_t timeoutTicks, BENCH_RESULT *result)
+{
+    uint32_t start;
+    uint32_t microseconds;
+    uint8_t data;
+    uint8_t i;
+
+    result->latencyMinMicroseconds = 0xFFFF;
+    result->latencyMaxMicroseconds = 0;
+
+    for(i = 0; i < BENCH_PINGS; i++)
+    {
+        data = (uint8_t)~i;
+        start = TIME_NowTicks();
+        UART_PutChar(i);
+
+        while(!UART_GetChar(&data))
+        {
+            if(TIME_ElapsedTicks(start) > timeoutTicks)
+            {
+                break;
+            }
+        }
+
+        microseconds = TIME_TicksToMicroseconds(TIME_ElapsedTicks(start));
+        if((data != i) || (microseconds > 0xFFFF))
+        {
+            result->errors++;
+            continue;
+        }
+
+        if(microseconds < result->latencyMinMicroseconds)
+        {
+            result->latencyMinMicroseconds = (uint16_t)microseconds;
+        }
+        if(microseconds > result->latencyMaxMicroseconds)
+        {
+            result->latencyMaxMicroseconds = (uint16_t)microseconds;
+        }
+    }
+
+    if(result->latencyMinMicroseconds > result->latencyMaxMicroseconds)
+    {
+        result->latencyMinMicroseconds = 0;
+    }
+}
+
+/*******************************************************************************
+
+  Function:
+   static void BENCH_Report( uint16_t payloadBytes )
+
+  Summary:
+    Prints the result table over UART1
+
+ */
+static void BENCH_Report(uint16_t payloadBytes)
+{
+    const BENCH_RESULT *result;
+    uint8_t i;
+
+    PRINT_SetConfiguration(PRINT_CONFIGURATION_UART);
+
+    PRINT_Formatted("loopback, %u bytes per rate, FCY %lu Hz\r\n", payloadBytes, SYSTEM_PERIPHERAL_CLOCK);
+    PRINT_Formatted("   baud    B/s cyc/B  tx int  rx int lat us min/max errors\r\n");
+
+    for(i = 0; i < BENCH_RATE_COUNT; i++)
+    {
+        result = &benchResults[i];
+        PRINT_Formatted("%7lu %6lu %5u %7u %7u %6u/%7u %6u\r\n",
+                        result->baud, result->bytesPerSecond, result->cyclesPerByte,
+                        result->txInterrupts, result->rxInterrupts,
+                        result->latencyMinMicroseconds, result->latencyMaxMicroseconds,
+                        result->errors);
+    }
+}
+
+/*******************************************************************************
+
+  Function:
+   static void BENCH_Display( void )
+
+  Summary:
+    Shows the fastest error free rate on the LCD for BENCH_LCD_HOLD_MS
+
+ */
+static void BENCH_Display(void)
+{
+    char row[BENCH_LCD_COLUMNS + 1];
+    const BENCH_RESULT *best = NULL;
+    uint8_t i;
+
+    for(i = 0; i < BENCH_RATE_COUNT; i++)
+    {
+        if((benchResults[i].baud != 0) && (benchResults[i].errors == 0))
+        {
+            best = &benchResults[i];
+        }
+    }
+
+    // Keep the clock display off the LCD while the result is shown
+    appData.flags.lcd_hold = 1;
+    TIMER_RequestOneShot(BENCH_LcdRelease, BENCH_LCD_HOLD_MS);
+
+    PRINT_BufferSet(row, sizeof(row));
+    PRINT_SetConfiguration(PRINT_CONFIGURATION_BUFFER);
+    if(best == NULL)
+    {
+        PRINT_Formatted("bench failed");
+    }
+    else
+    {
+        PRINT_Formatted("%6lu %5luB/s", best->baud, best->bytesPerSecond);
+    }
+    BENCH_LcdRow(row);
+
+    PRINT_BufferSet(row, sizeof(row));
+    PRINT_SetConfiguration(PRINT_CONFIGURATION_BUFFER);
+    if(best != NULL)
+    {
+        PRINT_Formatted("%3u cyc/B %4uus", best->cyclesPerByte, best->latencyMaxMicroseconds);
+    }
+    BENCH_LcdRow(row);
+}
+
+/*******************************************************************************
+
+  Function:
+   static void BENCH_LcdRow( char *row )
+
+  Summary:
+    Pads a formatted row to the LCD width and writes it
+
+  Description:
+    Every write is exactly one full row, so after two rows the cursor is
+    back at the home position, as APP_DisplayTasks() expects.
+
+ */
+static void BENCH_LcdRow(char *row)
+{
+    uint16_t length = PRINT_BufferLength();
+
+    while(length < BENCH_LCD_COLUMNS)
+    {
+        row[length++] = ' ';
+    }
+
+    PRINT_SetConfiguration(PRINT_CONFIGURATION_LCD);
+    PRINT_String(row, BENCH_LCD_COLUMNS);
+}
+
+/*******************************************************************************
+
+  Function:
+   static void BENCH_LcdRelease( void )
+
+  Summary:
+    Hands the LCD back to the clock display
+
+  Remarks:
+    Runs in the Timer 2 interrupt.
+ */
+static void BENCH_LcdRelease(void)
+{
+    appData.flags.lcd_hold = 0;
+    appData.flags.rtc_lcd_update = 1;
+}
@@ -0,0 +1,124 @@
+/*******************************************************************************
+ Explorer 16 Demo UART Benchmark Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    benchmark.h
+
+  Summary:
+    UART1 loopback throughput and latency benchmark
+
+  Description:
+    Runs UART1 in internal loopback at each supported bit rate and measures
+    throughput, driver CPU cost, interrupt counts and round trip latency.
+ *******************************************************************************/
+
+// DOM-IGNORE-BEGIN
+/*******************************************************************************
+Copyright (c) 2013 released Microchip Technology Inc.  All rights reserved.
+
+Microchip licenses to you the right to use, modify, copy and distribute
+Software only when embedded on a Microchip microcontroller or digital signal
+controller that is integrated into your product or third party product
+(pursuant to the sublicense terms in the accompanying license agreement).
+
+You should refer to the license agreement accompanying this Software for
+additional information regarding your rights and obligations.
+
+SOFTWARE AND DOCUMENTATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY WARRANTY OF
+MERCHANTABILITY, TITLE, NON-INFRINGEMENT AND FITNESS FOR A PARTICULAR PURPOSE.
+IN NO EVENT SHALL MICROCHIP OR ITS LICENSORS BE LIABLE OR OBLIGATED UNDER
+CONTRACT, NEGLIGENCE, STRICT LIABILITY, CONTRIBUTION, BREACH OF WARRANTY, OR
+OTHER LEGAL EQUITABLE THEORY ANY DIRECT OR INDIRECT DAMAGES OR EXPENSES
+INCLUDING BUT NOT LIMITED TO ANY INCIDENTAL, SPECIAL, INDIRECT, PUNITIVE OR
+CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, COST OF PROCUREMENT OF
+SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
+(INCLUDING BUT NOT LIMITED TO ANY DEFENSE THEREOF), OR OTHER SIMILAR COSTS.
+ *******************************************************************************/
+// DOM-IGNORE-END
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Constants and Data Types
+// *****************************************************************************
+// *****************************************************************************
+
+#define BENCH_DEFAULT_PAYLOAD   64
+#define BENCH_MAX_PAYLOAD       1024
+
+/* Bit rates exercised, see benchmark.c */
+#define BENCH_RATE_COUNT        5
+
+typedef struct
+{
+    uint32_t baud;                  // rate actually set
+    uint32_t bytesPerSecond;        // payload through TX and back through RX
+    uint16_t cyclesPerByte;         // UART interrupt and driver call cycles
+    uint16_t txInterrupts;
+    uint16_t rxInterrupts;
+    uint16_t latencyMinMicroseconds;    // single byte, UART_PutChar() to UART_GetChar()
+    uint16_t latencyMaxMicroseconds;
+    uint16_t errors;                // bytes lost, corrupted or timed out
+} BENCH_RESULT;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+/*******************************************************************************
+
+  Function:
+   bool BENCH_Run( uint16_t payloadBytes )
+
+  Summary:
+    Runs the loopback benchmark at every rate and reports the results
+
+  Description:
+    Puts UART1 in loopback (LPBACK), pumps payloadBytes through the transmit
+    queue and back through the receive queue at each rate in turn, then
+    restores the original rate and prints a table over UART1. The fastest
+    error free rate is shown on the LCD for 10 seconds. Blocks for the
+    duration of the run (well under a second at the default payload).
+
+  Precondition:
+    UART_Initialize(), TIME_Initialize() and TIMER_SetConfiguration() have
+    been called. Called from the main loop only.
+
+  Parameters:
+    payloadBytes - bytes per rate, 1 to BENCH_MAX_PAYLOAD
+
+  Returns:
+    false if payloadBytes is out of range, true otherwise.
+
+ */
+bool BENCH_Run(uint16_t payloadBytes);
+
+/*******************************************************************************
+
+  Function:
+   const BENCH_RESULT *BENCH_ResultsGet( void )
+
+  Summary:
+    Returns the BENCH_RATE_COUNT results of the last run
+
+ */
+const BENCH_RESULT *BENCH_ResultsGet(void);
+
+#endif // BENCHMARK_H
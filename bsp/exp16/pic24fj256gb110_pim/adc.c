@@ -0,0 +1,194 @@
+/*
+ * File:   adc.c
+ *
+ * ADC1 runs in auto-sample, auto-convert scan mode over AN4 and AN5. The
+ * 16-word result buffer is split into two halves (BUFM = 1) so the
+ * interrupt reads one half while the converter fills the other, and only
+ * one interrupt is taken per 8 conversions (SMPI = 7).
+ */
+
+#include <xc.h>
+#include <adc.h>
+#include <timestamp.h>
+#include <trace.h>
+
+#define ADC_INTERRUPT_PRIORITY  2
+
+/* AD1CON1: integer format, internal counter ends sampling (SSRC = 111),
+ * sampling restarts automatically after each conversion (ASAM) */
+#define ADC_CON1_SETTINGS       0x00E4
+#define ADC_CON1_ADON           0x8000
+
+/* AD1CON2: AVdd/AVss reference, scan inputs (CSCNA), interrupt every 8th
+ * conversion (SMPI = 0111), two 8-word buffer halves (BUFM) */
+#define ADC_CON2_SETTINGS       0x041E
+
+/* AD1CON3: system clock, SAMC = 31 TAD, TAD = 256 TCY (64 us at 4 MHz).
+ * Each conversion takes 31 + 12 TAD = 2.75 ms, so a batch completes every
+ * 22 ms and each channel is sampled at about 180 Hz. */
+#define ADC_CON3_SETTINGS       0x1FFF
+
+#define ADC_SCAN_MASK           ((1 << ADC_CHANNEL_TEMPERATURE) | (1 << ADC_CHANNEL_POTENTIOMETER))
+
+static ADC_BATCH adcQueue[ADC_BATCH_QUEUE_SIZE];
+static volatile uint8_t adcQueueHead;   // written by the interrupt only
+static volatile uint8_t adcQueueTail;   // written by ADC_BatchGet only
+static volatile uint16_t adcOverruns;
+static volatile uint16_t adcLatest[ADC_SCAN_CHANNELS];
+
+/*********************************************************************
+* Function: ADC_Initialize(void);
+*
+* Overview: Starts continuous auto-scan of AN4 and AN5
+*
+* PreCondition: TIME_Initialize()
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+void ADC_Initialize(void)
+{
+    AD1CON1 = 0;                        // stop the converter while it is set up
+
+    TRISB |= ADC_SCAN_MASK;
+    AD1PCFGL &= ~ADC_SCAN_MASK;         // analog inputs
+
+    AD1CHS = 0;                         // CH0 negative input is VR-, positive comes from the scan
+    AD1CSSL = ADC_SCAN_MASK;
+    AD1CON3 = ADC_CON3_SETTINGS;
+    AD1CON2 = ADC_CON2_SETTINGS;
+    AD1CON1 = ADC_CON1_SETTINGS;
+
+    adcQueueHead = 0;
+    adcQueueTail = 0;
+    adcOverruns = 0;
+
+    IFS0bits.AD1IF = 0;
+    IPC3bits.AD1IP = ADC_INTERRUPT_PRIORITY;
+    IEC0bits.AD1IE = 1;
+
+    AD1CON1 |= ADC_CON1_ADON;
+}
+
+/*********************************************************************
+* Function: ADC_Read10bit(ADC_CHANNEL channel);
+*
+* Overview: Returns the channel average from the most recent batch
+*
+* PreCondition: ADC_Initialize()
+*
+* Input: ADC_CHANNEL channel - channel to read
+*
+* Output: uint16_t - 10-bit result
+*
+********************************************************************/
+uint16_t ADC_Read10bit(ADC_CHANNEL channel)
+{
+    return adcLatest[ADC_SCAN_INDEX(channel)];
+}
+
+/*********************************************************************
+* Function: ADC_BatchGet(ADC_BATCH *batch);
+*
+* Overview: Takes the oldest completed batch from the queue
+*
+* PreCondition: ADC_Initialize()
+*
+* Input: ADC_BATCH *batch - where to copy the batch
+*
+* Output: true if a batch was copied, false if the queue is empty
+*
+********************************************************************/
+bool ADC_BatchGet(ADC_BATCH *batch)
+{
+    uint8_t tail = adcQueueTail;
+
+    if (tail == adcQueueHead)
+    {
+        return false;
+    }
+
+    *batch = adcQueue[tail];
+    adcQueueTail = (tail + 1) % ADC_BATCH_QUEUE_SIZE;
+
+    return true;
+}
+
+/*********************************************************************
+* Function: ADC_BatchOverrunGet(void);
+*
+* Overview: Returns the number of dropped batches
+*
+* PreCondition: ADC_Initialize()
+*
+* Input: none
+*
+* Output: uint16_t - dropped batch count
+*
+********************************************************************/
+uint16_t ADC_BatchOverrunGet(void)
+{
+    return adcOverruns;
+}
+
+/*********************************************************************
+* Function: _ADC1Interrupt(void);
+*
+* Overview: Copies the half of ADC1BUF that the converter is not filling
+*           into the batch queue. The converter has 8 conversions (22 ms)
+*           before it wraps back onto this half.
+*
+* PreCondition: ADC_Initialize()
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+void __attribute__ ( ( __interrupt__ , auto_psv ) ) _ADC1Interrupt ( void )
+{
+    volatile unsigned int *buffer;
+    uint16_t sum[ADC_SCAN_CHANNELS] = {0, 0};
+    uint8_t head;
+    uint8_t next;
+    uint8_t i;
+    ADC_BATCH *batch;
+
+    IFS0bits.AD1IF = 0;
+
+    /* BUFS set: the converter is filling ADC1BUF8-F, 0-7 are ready */
+    buffer = AD1CON2bits.BUFS ? &ADC1BUF0 : &ADC1BUF8;
+
+    head = adcQueueHead;
+    next = (head + 1) % ADC_BATCH_QUEUE_SIZE;
+
+    if (next == adcQueueTail)
+    {
+        /* Queue full: still refresh the latest values, drop the batch */
+        adcOverruns++;
+        for (i = 0; i < ADC_BATCH_CONVERSIONS; i++)
+        {
+            sum[i % ADC_SCAN_CHANNELS] += buffer[i];
+        }
+    }
+    else
+    {
+        batch = &adcQueue[head];
+        batch->timestamp = TIME_NowTicks();
+        for (i = 0; i < ADC_BATCH_CONVERSIONS; i++)
+        {
+            batch->sample[i % ADC_SCAN_CHANNELS][i / ADC_SCAN_CHANNELS] = buffer[i];
+            sum[i % ADC_SCAN_CHANNELS] += buffer[i];
+        }
+        adcQueueHead = next;
+    }
+
+    for (i = 0; i < ADC_SCAN_CHANNELS; i++)
+    {
+        adcLatest[i] = sum[i] / ADC_SAMPLES_PER_CHANNEL; // power of two, compiles to a shift
+    }
+
+    TRACE_Event(TRACE_EVENT_ADC_BATCH, adcLatest[ADC_SCAN_INDEX(ADC_CHANNEL_POTENTIOMETER)]);
+}
@@ -0,0 +1,122 @@
+/* Microchip Technology Inc. and its subsidiaries.  You may use this software 
+ * and any derivatives exclusively with Microchip products. 
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES, WHETHER 
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED 
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A 
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION 
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION. 
+ *
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, 
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND 
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS 
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE 
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS 
+ * IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF 
+ * ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE 
+ * TERMS. 
+ */
+
+/* 
+ * File:   adc.h
+ * Author: 
+ * Comments: Auto-scanning ADC1 driver for the potentiometer and temperature sensor
+ * Revision history: 
+ */
+
+// This is a guard condition so that contents of this file are not included
+// more than once.  
+#ifndef ADC_H
+#define	ADC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Type Definitions *************************************************/
+typedef enum
+{
+    ADC_CHANNEL_TEMPERATURE = 4,    // TC1047A on AN4/RB4
+    ADC_CHANNEL_POTENTIOMETER = 5   // R6 on AN5/RB5
+} ADC_CHANNEL;
+
+/* Channels are scanned in ascending order, AN4 then AN5 */
+#define ADC_SCAN_CHANNELS           2
+#define ADC_SCAN_INDEX(channel)     ((channel) - ADC_CHANNEL_TEMPERATURE)
+
+/* One batch is one half of ADC1BUF (BUFM = 1): 8 conversions, 4 per channel */
+#define ADC_BATCH_CONVERSIONS       8
+#define ADC_SAMPLES_PER_CHANNEL     (ADC_BATCH_CONVERSIONS / ADC_SCAN_CHANNELS)
+
+/* Batches buffered between the interrupt and the application */
+#define ADC_BATCH_QUEUE_SIZE        4
+
+typedef struct
+{
+    uint32_t timestamp;     // TIME_NowTicks() when the half buffer completed
+    uint16_t sample[ADC_SCAN_CHANNELS][ADC_SAMPLES_PER_CHANNEL];   // [ADC_SCAN_INDEX(channel)][n]
+} ADC_BATCH;
+
+/*********************************************************************
+* Function: ADC_Initialize(void);
+*
+* Overview: Starts continuous auto-scan of the temperature sensor and
+*           the potentiometer. Conversions run back to back without CPU
+*           involvement; one interrupt is taken per half buffer.
+*
+* PreCondition: TIME_Initialize()
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+void ADC_Initialize(void);
+
+/*********************************************************************
+* Function: ADC_Read10bit(ADC_CHANNEL channel);
+*
+* Overview: Returns the average of the channel's samples in the most
+*           recent batch. Does not block and does not consume batches.
+*
+* PreCondition: ADC_Initialize()
+*
+* Input: ADC_CHANNEL channel - channel to read
+*
+* Output: uint16_t - 10-bit result, 0 before the first batch
+*
+********************************************************************/
+uint16_t ADC_Read10bit(ADC_CHANNEL channel);
+
+/*********************************************************************
+* Function: ADC_BatchGet(ADC_BATCH *batch);
+*
+* Overview: Takes the oldest completed batch from the queue
+*
+* PreCondition: ADC_Initialize()
+*
+* Input: ADC_BATCH *batch - where to copy the batch
+*
+* Output: true if a batch was copied, false if the queue is empty
+*
+********************************************************************/
+bool ADC_BatchGet(ADC_BATCH *batch);
+
+/*********************************************************************
+* Function: ADC_BatchOverrunGet(void);
+*
+* Overview: Returns the number of batches dropped because the queue
+*           was full when the interrupt ran
+*
+* PreCondition: ADC_Initialize()
+*
+* Input: none
+*
+* Output: uint16_t - dropped batch count
+*
+********************************************************************/
+uint16_t ADC_BatchOverrunGet(void);
+
+#endif	/* ADC_H */
+
@@ -0,0 +1,788 @@
+/*
+ * File:   eeprom.c
+ *
+ * 25LC256 serial EEPROM on SPI1. Writes land in a small cache of whole
+ * pages and are programmed a page at a time, so a burst of byte writes
+ * costs one 5 ms program cycle instead of one per byte. The program
+ * cycle is timed by polling the write-in-progress bit from the 1 ms
+ * tick rather than by a fixed delay.
+ */
+
+#include <xc.h>
+#include <string.h>
+#include <eeprom.h>
+#include <spi.h>
+#include <timer_1ms.h>
+#include <timestamp.h>
+
+/* 25LC256 instructions */
+#define EEPROM_COMMAND_READ     0x03
+#define EEPROM_COMMAND_WRITE    0x02
+#define EEPROM_COMMAND_WREN     0x06
+#define EEPROM_COMMAND_RDSR     0x05
+
+#define EEPROM_STATUS_WIP       0x01 // write in progress
+
+#define EEPROM_CLOCK            5000000UL // limit below 4.5 V
+#define EEPROM_MODE             0
+
+#define EEPROM_PAGE_MASK        (EEPROM_PAGE_SIZE - 1)
+
+#define EEPROM_BUSY_TIMEOUT_TICKS   (EEPROM_BUSY_TIMEOUT * 1000UL * TIME_TICKS_PER_MICRO_SECOND)
+
+#if (EEPROM_PAGE_SIZE & EEPROM_PAGE_MASK) != 0
+#error "EEPROM_PAGE_SIZE must be a power of two"
+#endif
+
+typedef enum
+{
+    EEPROM_STATE_IDLE = 0,
+    EEPROM_STATE_WRITE,         // WREN and WRITE queued on SPI1
+    EEPROM_STATE_POLL           // page programming, RDSR each tick
+} EEPROM_STATE;
+
+typedef struct
+{
+    uint16_t page;              // address / EEPROM_PAGE_SIZE
+    uint16_t lastUse;           // eepromUseCount when last touched
+    volatile uint8_t idle;      // ms since the last write while dirty
+    volatile bool valid;
+    volatile bool dirty;        // written since the last program
+    volatile bool locked;       // being changed by EEPROM_Write()
+    volatile bool writing;      // being programmed from data[]
+    uint8_t data[EEPROM_PAGE_SIZE];
+} EEPROM_LINE;
+
+static SPI_DEVICE eepromDevice =
+{
+    &LATD, 0x1000, EEPROM_CLOCK, EEPROM_MODE, 8, 0 // CS on RD12
+};
+
+static EEPROM_LINE eepromLines[EEPROM_CACHE_LINES];
+static uint16_t eepromUseCount;
+static volatile EEPROM_STATE eepromState;
+static volatile bool eepromReading; // main owns the part for a read
+static EEPROM_LINE *eepromWriteLine; // line being programmed
+static volatile EEPROM_STATISTICS eepromStatistics; // also counted in the SPI1 interrupt
+
+static uint8_t eepromWrenCommand[1] = { EEPROM_COMMAND_WREN };
+static uint8_t eepromWriteHeader[3];
+static uint8_t eepromReadHeader[3];
+static uint8_t eepromStatusCommand[2] = { EEPROM_COMMAND_RDSR, 0 };
+static uint8_t eepromStatus[2];
+
+static SPI_SEGMENT eepromWrenSegments[1];
+static SPI_SEGMENT eepromWriteSegments[2]; // header, cached page
+static SPI_SEGMENT eepromReadSegments[2]; // header, destination
+static SPI_SEGMENT eepromStatusSegments[1];
+
+static SPI_TRANSACTION eepromWrenTransaction;
+static SPI_TRANSACTION eepromWriteTransaction;
+static SPI_TRANSACTION eepromReadTransaction;
+static SPI_TRANSACTION eepromStatusTransaction;
+
+static bool EEPROM_RangeValid(uint16_t address, uint16_t length);
+static EEPROM_LINE *EEPROM_LineFind(uint16_t page);
+static EEPROM_LINE *EEPROM_LineGet(uint16_t page, bool fill);
+static EEPROM_LINE *EEPROM_LineEvict(void);
+static bool EEPROM_LineLock(EEPROM_LINE *line);
+static bool EEPROM_TimedOut(uint32_t start);
+static bool EEPROM_PartRead(uint16_t address, void *data, uint16_t length);
+static void EEPROM_WriteBackStart(EEPROM_LINE *line);
+static void EEPROM_Tick(void);
+static void EEPROM_WriteDone(SPI_TRANSACTION *transaction);
+static void EEPROM_StatusDone(SPI_TRANSACTION *transaction);
+
+/*********************************************************************
+* Function: EEPROM_Initialize(void);
+*
+* Overview: Sets up the 25LC256 on SPI1 and empties the cache
+*
+* PreCondition: SPI_Initialize()
+*
+* Input: none
+*
+* Output: true if the SPI clock could be set
+*
+********************************************************************/
+bool EEPROM_Initialize(void)
+{
+    memset(eepromLines, 0, sizeof(eepromLines));
+    memset((void *)&eepromStatistics, 0, sizeof(eepromStatistics));
+    eepromUseCount = 0;
+    eepromState = EEPROM_STATE_IDLE;
+    eepromReading = false;
+
+    eepromWrenSegments[0].tx = eepromWrenCommand;
+    eepromWrenSegments[0].rx = NULL;
+    eepromWrenSegments[0].length = sizeof(eepromWrenCommand);
+
+    eepromWriteSegments[0].tx = eepromWriteHeader;
+    eepromWriteSegments[0].rx = NULL;
+    eepromWriteSegments[0].length = sizeof(eepromWriteHeader);
+    eepromWriteSegments[1].rx = NULL;
+    eepromWriteSegments[1].length = EEPROM_PAGE_SIZE;
+
+    eepromReadSegments[0].tx = eepromReadHeader;
+    eepromReadSegments[0].rx = NULL;
+    eepromReadSegments[0].length = sizeof(eepromReadHeader);
+    eepromReadSegments[1].tx = NULL;
+
+    eepromStatusSegments[0].tx = eepromStatusCommand;
+    eepromStatusSegments[0].rx = eepromStatus;
+    eepromStatusSegments[0].length = sizeof(eepromStatusCommand);
+
+    eepromWrenTransaction.device = &eepromDevice;
+    eepromWrenTransaction.segments = eepromWrenSegments;
+    eepromWrenTransaction.segmentCount = 1;
+    eepromWrenTransaction.callback = NULL;
+
+    eepromWriteTransaction.device = &eepromDevice;
+    eepromWriteTransaction.segments = eepromWriteSegments;
+    eepromWriteTransaction.segmentCount = 2;
+    eepromWriteTransaction.callback = EEPROM_WriteDone;
+
+    eepromReadTransaction.device = &eepromDevice;
+    eepromReadTransaction.segments = eepromReadSegments;
+    eepromReadTransaction.segmentCount = 2;
+    eepromReadTransaction.callback = NULL;
+
+    eepromStatusTransaction.device = &eepromDevice;
+    eepromStatusTransaction.segments = eepromStatusSegments;
+    eepromStatusTransaction.segmentCount = 1;
+    eepromStatusTransaction.callback = EEPROM_StatusDone;
+
+    return (SPI_DeviceInitialize(&eepromDevice) != 0);
+}
+
+/*********************************************************************
+* Function: EEPROM_Read(uint16_t address, void *data, uint16_t length);
+*
+* Overview: Reads bytes from the cache or the part
+*
+* PreCondition: EEPROM_Initialize(), not called from an interrupt
+*
+* Input: uint16_t address - first byte
+*        void *data - destination
+*        uint16_t length - number of bytes
+*
+* Output: true if read, false if out of range or the part stayed busy
+*
+********************************************************************/
+bool EEPROM_Read(uint16_t address, void *data, uint16_t length)
+{
+    uint8_t *destination = data;
+    EEPROM_LINE *line;
+    uint16_t offset;
+    uint16_t chunk;
+
+    if(EEPROM_RangeValid(address, length) == false)
+    {
+        return false;
+    }
+
+    while(length != 0)
+    {
+        offset = address & EEPROM_PAGE_MASK;
+        chunk = EEPROM_PAGE_SIZE - offset;
+        if(chunk > length)
+        {
+            chunk = length;
+        }
+
+        line = EEPROM_LineFind(address / EEPROM_PAGE_SIZE);
+        if(line != NULL)
+        {
+            memcpy(destination, &line->data[offset], chunk);
+            line->lastUse = ++eepromUseCount;
+            eepromStatistics.readHits++;
+        }
+        else
+        {
+            if(EEPROM_PartRead(address, destination, chunk) == false)
+            {
+                return false;
+            }
+            eepromStatistics.readMisses++;
+        }
+
+        address += chunk;
+        destination += chunk;
+        length -= chunk;
+    }
+
+    return true;
+}
+
+/*********************************************************************
+* Function: EEPROM_Write(uint16_t address, const void *data, uint16_t length);
+*
+* Overview: Writes bytes into the cache for a later page program
+*
+* PreCondition: EEPROM_Initialize(), TIMER_SetConfiguration(), not
+*               called from an interrupt
+*
+* Input: uint16_t address - first byte
+*        const void *data - source
+*        uint16_t length - number of bytes
+*
+* Output: true if cached, false if out of range, the cache stayed busy
+*         or the write back tick could not be started
+*
+********************************************************************/
+bool EEPROM_Write(uint16_t address, const void *data, uint16_t length)
+{
+    const uint8_t *source = data;
+    EEPROM_LINE *line;
+    uint16_t offset;
+    uint16_t chunk;
+    uint16_t ipl;
+
+    if(EEPROM_RangeValid(address, length) == false)
+    {
+        return false;
+    }
+
+    while(length != 0)
+    {
+        offset = address & EEPROM_PAGE_MASK;
+        chunk = EEPROM_PAGE_SIZE - offset;
+        if(chunk > length)
+        {
+            chunk = length;
+        }
+
+        // a whole page is overwritten, so there is nothing to read in
+        line = EEPROM_LineGet(address / EEPROM_PAGE_SIZE, chunk != EEPROM_PAGE_SIZE);
+        if(line == NULL)
+        {
+            return false;
+        }
+
+        memcpy(&line->data[offset], source, chunk);
+
+        SET_AND_SAVE_CPU_IPL(ipl, 7);
+        line->dirty = true;
+        line->idle = 0;
+        line->locked = false;
+        RESTORE_CPU_IPL(ipl);
+
+        // the data is cached, but nothing would ever program it
+        if(TIMER_RequestTick(EEPROM_Tick, 1) == false)
+        {
+            return false;
+        }
+
+        address += chunk;
+        source += chunk;
+        length -= chunk;
+    }
+
+    return true;
+}
+
+/*********************************************************************
+* Function: EEPROM_Flush(void);
+*
+* Overview: Starts writing back every dirty page
+*
+* PreCondition: EEPROM_Initialize(), TIMER_SetConfiguration()
+*
+* Input: none
+*
+* Output: true if started, false if the tick could not be requested
+*
+********************************************************************/
+bool EEPROM_Flush(void)
+{
+    uint8_t i;
+
+    for(i = 0; i < EEPROM_CACHE_LINES; i++)
+    {
+        if(eepromLines[i].dirty)
+        {
+            eepromLines[i].idle = EEPROM_WRITE_BACK_DELAY;
+            if(TIMER_RequestTick(EEPROM_Tick, 1) == false)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/*********************************************************************
+* Function: EEPROM_IsBusy(void);
+*
+* Overview: Reports whether dirty pages or a page program are pending
+*
+* PreCondition: EEPROM_Initialize()
+*
+* Input: none
+*
+* Output: true until every write has been programmed
+*
+********************************************************************/
+bool EEPROM_IsBusy(void)
+{
+    uint8_t i;
+
+    if(eepromState != EEPROM_STATE_IDLE)
+    {
+        return true;
+    }
+
+    for(i = 0; i < EEPROM_CACHE_LINES; i++)
+    {
+        if(eepromLines[i].dirty)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*********************************************************************
+* Function: EEPROM_StatisticsGet(EEPROM_STATISTICS *statistics);
+*
+* Overview: Copies the cache and program counters
+*
+* PreCondition: EEPROM_Initialize()
+*
+* Input: EEPROM_STATISTICS *statistics - where to copy the counters
+*
+* Output: none
+*
+********************************************************************/
+void EEPROM_StatisticsGet(EEPROM_STATISTICS *statistics)
+{
+    uint16_t ipl;
+
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    *statistics = eepromStatistics;
+    RESTORE_CPU_IPL(ipl);
+}
+
+/*********************************************************************
+* Function: EEPROM_RangeValid(uint16_t address, uint16_t length);
+*
+* Overview: Checks that a byte range lies inside the part
+*
+* PreCondition: none
+*
+* Input: uint16_t address - first byte
+*        uint16_t length - number of bytes
+*
+* Output: true if inside
+*
+********************************************************************/
+static bool EEPROM_RangeValid(uint16_t address, uint16_t length)
+{
+    return (((uint32_t)address + length) <= EEPROM_SIZE);
+}
+
+/*********************************************************************
+* Function: EEPROM_LineFind(uint16_t page);
+*
+* Overview: Looks a page up in the cache
+*
+* PreCondition: none
+*
+* Input: uint16_t page - page number
+*
+* Output: EEPROM_LINE * - line holding the page, NULL if not cached
+*
+********************************************************************/
+static EEPROM_LINE *EEPROM_LineFind(uint16_t page)
+{
+    uint8_t i;
+
+    for(i = 0; i < EEPROM_CACHE_LINES; i++)
+    {
+        if(eepromLines[i].valid && (eepromLines[i].page == page))
+        {
+            return &eepromLines[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*********************************************************************
+* Function: EEPROM_LineGet(uint16_t page, bool fill);
+*
+* Overview: Finds or allocates the line for a page and locks it for
+*           writing. A newly allocated line is read in from the part
+*           when fill is set.
+*
+* PreCondition: Not called from an interrupt
+*
+* Input: uint16_t page - page number
+*        bool fill - read the page in if it is not cached
+*
+* Output: EEPROM_LINE * - locked line, NULL if no line came free or
+*         the part could not be read
+*
+********************************************************************/
+static EEPROM_LINE *EEPROM_LineGet(uint16_t page, bool fill)
+{
+    EEPROM_LINE *line = EEPROM_LineFind(page);
+
+    if(line == NULL)
+    {
+        line = EEPROM_LineEvict();
+        if(line == NULL)
+        {
+            return NULL;
+        }
+
+        if(fill)
+        {
+            if(EEPROM_PartRead(page * EEPROM_PAGE_SIZE, line->data, EEPROM_PAGE_SIZE) == false)
+            {
+                return NULL;
+            }
+            eepromStatistics.pageFills++;
+        }
+
+        line->page = page;
+        line->valid = true;
+    }
+
+    if(EEPROM_LineLock(line) == false)
+    {
+        return NULL;
+    }
+    line->lastUse = ++eepromUseCount;
+
+    return line;
+}
+
+/*********************************************************************
+* Function: EEPROM_LineEvict(void);
+*
+* Overview: Frees the least recently used line, waiting up to
+*           EEPROM_BUSY_TIMEOUT ms for its page to be programmed if it
+*           is dirty. The wait makes no progress while SPI1 streams.
+*
+* PreCondition: Not called from an interrupt
+*
+* Input: none
+*
+* Output: EEPROM_LINE * - free line, NULL if the victim stayed busy
+*
+********************************************************************/
+static EEPROM_LINE *EEPROM_LineEvict(void)
+{
+    EEPROM_LINE *victim = &eepromLines[0];
+    uint32_t start;
+    uint16_t age;
+    uint16_t oldest = 0;
+    uint8_t i;
+
+    for(i = 0; i < EEPROM_CACHE_LINES; i++)
+    {
+        if(eepromLines[i].valid == false)
+        {
+            return &eepromLines[i];
+        }
+
+        age = eepromUseCount - eepromLines[i].lastUse;
+        if(age >= oldest)
+        {
+            oldest = age;
+            victim = &eepromLines[i];
+        }
+    }
+
+    if(victim->dirty)
+    {
+        victim->idle = EEPROM_WRITE_BACK_DELAY; // write back on the next tick
+        if(TIMER_RequestTick(EEPROM_Tick, 1) == false)
+        {
+            return NULL;
+        }
+    }
+
+    start = TIME_NowTicks();
+    while(victim->dirty || victim->writing)
+    {
+        if(EEPROM_TimedOut(start))
+        {
+            return NULL;
+        }
+    }
+
+    victim->valid = false;
+
+    return victim;
+}
+
+/*********************************************************************
+* Function: EEPROM_LineLock(EEPROM_LINE *line);
+*
+* Overview: Waits until a line is not being programmed and marks it
+*           locked so the tick leaves it alone while it is changed
+*
+* PreCondition: Not called from an interrupt
+*
+* Input: EEPROM_LINE *line - line to lock
+*
+* Output: true if locked, false if the page program did not finish
+*         within EEPROM_BUSY_TIMEOUT ms
+*
+********************************************************************/
+static bool EEPROM_LineLock(EEPROM_LINE *line)
+{
+    uint32_t start = TIME_NowTicks();
+    uint16_t ipl;
+
+    while(1)
+    {
+        SET_AND_SAVE_CPU_IPL(ipl, 7);
+        if(line->writing == false)
+        {
+            line->locked = true;
+            RESTORE_CPU_IPL(ipl);
+            return true;
+        }
+        RESTORE_CPU_IPL(ipl);
+
+        if(EEPROM_TimedOut(start))
+        {
+            return false;
+        }
+    }
+}
+
+/*********************************************************************
+* Function: EEPROM_TimedOut(uint32_t start);
+*
+* Overview: Bounds the waits for the write back machine, which stops
+*           making progress while SPI1 streams
+*
+* PreCondition: TIME_Initialize()
+*
+* Input: uint32_t start - TIME_NowTicks() when the wait began
+*
+* Output: true once EEPROM_BUSY_TIMEOUT ms have passed
+*
+********************************************************************/
+static bool EEPROM_TimedOut(uint32_t start)
+{
+    return (TIME_ElapsedTicks(start) >= EEPROM_BUSY_TIMEOUT_TICKS);
+}
+
+/*********************************************************************
+* Function: EEPROM_PartRead(uint16_t address, void *data, uint16_t length);
+*
+* Overview: Reads bytes straight from the part. The part ignores reads
+*           while it programs a page, so this waits for the write back
+*           machine to be idle and keeps it idle until the read is in.
+*
+* PreCondition: Not called from an interrupt
+*
+* Input: uint16_t address - first byte
+*        void *data - destination
+*        uint16_t length - number of bytes
+*
+* Output: true if read, false if the part stayed busy for
+*         EEPROM_BUSY_TIMEOUT ms or SPI1 refused the transaction
+*
+********************************************************************/
+static bool EEPROM_PartRead(uint16_t address, void *data, uint16_t length)
+{
+    uint32_t start = TIME_NowTicks();
+    uint16_t ipl;
+    bool queued;
+
+    while(1)
+    {
+        SET_AND_SAVE_CPU_IPL(ipl, 7);
+        if(eepromState == EEPROM_STATE_IDLE)
+        {
+            eepromReading = true;
+            RESTORE_CPU_IPL(ipl);
+            break;
+        }
+        RESTORE_CPU_IPL(ipl);
+
+        if(EEPROM_TimedOut(start))
+        {
+            return false;
+        }
+    }
+
+    eepromReadHeader[0] = EEPROM_COMMAND_READ;
+    eepromReadHeader[1] = address >> 8;
+    eepromReadHeader[2] = address & 0xFF;
+    eepromReadSegments[1].rx = data;
+    eepromReadSegments[1].length = length;
+
+    queued = SPI_TransactionQueue(&eepromReadTransaction);
+    if(queued)
+    {
+        while(eepromReadTransaction.status != SPI_TRANSACTION_DONE)
+        {
+        }
+    }
+
+    eepromReading = false;
+
+    return queued;
+}
+
+/*********************************************************************
+* Function: EEPROM_WriteBackStart(EEPROM_LINE *line);
+*
+* Overview: Queues the write enable and the page write for a line
+*
+* PreCondition: Called from EEPROM_Tick() with the machine idle
+*
+* Input: EEPROM_LINE *line - dirty, unlocked line
+*
+* Output: none
+*
+********************************************************************/
+static void EEPROM_WriteBackStart(EEPROM_LINE *line)
+{
+    uint16_t address = line->page * EEPROM_PAGE_SIZE;
+
+    eepromWriteHeader[0] = EEPROM_COMMAND_WRITE;
+    eepromWriteHeader[1] = address >> 8;
+    eepromWriteHeader[2] = address & 0xFF;
+    eepromWriteSegments[1].tx = line->data;
+
+    // WREN needs its own chip select, so it is a separate transaction
+    if(SPI_TransactionQueue(&eepromWrenTransaction) == false)
+    {
+        return; // SPI1 is streaming, try again next tick
+    }
+
+    line->dirty = false;
+    line->writing = true;
+    eepromWriteLine = line;
+    eepromState = EEPROM_STATE_WRITE;
+
+    SPI_TransactionQueue(&eepromWriteTransaction);
+}
+
+/*********************************************************************
+* Function: EEPROM_Tick(void);
+*
+* Overview: 1 ms tick while the cache holds dirty pages or a page is
+*           programming. Starts the write back of a page whose write
+*           back delay has run out and polls the status register until
+*           a page program has finished. Cancels itself when there is
+*           nothing left to do.
+*
+* PreCondition: Called from the Timer 2 interrupt
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+static void EEPROM_Tick(void)
+{
+    EEPROM_LINE *line;
+    EEPROM_LINE *ready = NULL;
+    bool dirty = false;
+    uint8_t i;
+
+    for(i = 0; i < EEPROM_CACHE_LINES; i++)
+    {
+        line = &eepromLines[i];
+
+        if(line->dirty == false)
+        {
+            continue;
+        }
+
+        dirty = true;
+
+        if(line->locked)
+        {
+            continue;
+        }
+
+        if(line->idle < EEPROM_WRITE_BACK_DELAY)
+        {
+            line->idle++;
+        }
+
+        if((line->idle >= EEPROM_WRITE_BACK_DELAY) && (ready == NULL))
+        {
+            ready = line;
+        }
+    }
+
+    switch(eepromState)
+    {
+        case EEPROM_STATE_IDLE:
+            if((ready != NULL) && (eepromReading == false))
+            {
+                EEPROM_WriteBackStart(ready);
+            }
+            else if(dirty == false)
+            {
+                TIMER_CancelTick(EEPROM_Tick);
+            }
+            break;
+
+        case EEPROM_STATE_POLL:
+            if((eepromStatusTransaction.status != SPI_TRANSACTION_QUEUED) &&
+               (eepromStatusTransaction.status != SPI_TRANSACTION_ACTIVE))
+            {
+                if(SPI_TransactionQueue(&eepromStatusTransaction))
+                {
+                    eepromStatistics.statusPolls++;
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*********************************************************************
+* Function: EEPROM_WriteDone(SPI_TRANSACTION *transaction);
+*
+* Overview: The page has been sent and the part is programming it
+*
+* PreCondition: Called from the SPI1 interrupt
+*
+* Input: SPI_TRANSACTION *transaction - page write
+*
+* Output: none
+*
+********************************************************************/
+static void EEPROM_WriteDone(SPI_TRANSACTION *transaction)
+{
+    eepromStatistics.pageWrites++;
+    eepromState = EEPROM_STATE_POLL;
+}
+
+/*********************************************************************
+* Function: EEPROM_StatusDone(SPI_TRANSACTION *transaction);
+*
+* Overview: Ends the page program once write-in-progress has cleared
+*
+* PreCondition: Called from the SPI1 interrupt
+*
+* Input: SPI_TRANSACTION *transaction - status read
+*
+* Output: none
+*
+********************************************************************/
+static void EEPROM_StatusDone(SPI_TRANSACTION *transaction)
+{
+    if((eepromStatus[1] & EEPROM_STATUS_WIP) == 0)
+    {
+        eepromWriteLine->writing = false;
+        eepromState = EEPROM_STATE_IDLE;
+    }
+}
@@ -0,0 +1,168 @@
+/* Microchip Technology Inc. and its subsidiaries.  You may use this software
+ * and any derivatives exclusively with Microchip products.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ *
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS
+ * IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF
+ * ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+/*
+ * File:   eeprom.h
+ * Author:
+ * Comments: 25LC256 SPI EEPROM driver with a write-back page cache
+ * Revision history:
+ */
+
+// This is a guard condition so that contents of this file are not included
+// more than once.
+#ifndef EEPROM_H
+#define	EEPROM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* 25LC256: 32K bytes in 64 byte write pages */
+#define EEPROM_SIZE             32768UL
+#define EEPROM_PAGE_SIZE        64
+
+/* Cached pages. Each costs EEPROM_PAGE_SIZE bytes of RAM */
+#define EEPROM_CACHE_LINES      2
+
+/* A dirty page is written back once it has gone this many ms without a
+ * write, so bursts of small writes cost one page program */
+#define EEPROM_WRITE_BACK_DELAY 20
+
+/* Longest wait, in ms, for a page program to finish before a read,
+ * eviction or write gives up. Programming takes 5 ms at most, but
+ * nothing moves while SPI1 streams. */
+#define EEPROM_BUSY_TIMEOUT     50
+
+typedef struct
+{
+    uint16_t readHits;          // reads served from the cache
+    uint16_t readMisses;        // reads that went to the part
+    uint16_t pageFills;         // pages read in to take a write
+    uint16_t pageWrites;        // page programs started
+    uint16_t statusPolls;       // RDSR reads waiting for write-in-progress
+} EEPROM_STATISTICS;
+
+/*********************************************************************
+* Function: EEPROM_Initialize(void);
+*
+* Overview: Sets up the 25LC256 on SPI1 (CS on RD12) and empties the
+*           cache
+*
+* PreCondition: SPI_Initialize()
+*
+* Input: none
+*
+* Output: true if the SPI clock could be set
+*
+********************************************************************/
+bool EEPROM_Initialize(void);
+
+/*********************************************************************
+* Function: EEPROM_Read(uint16_t address, void *data, uint16_t length);
+*
+* Overview: Reads bytes, from the cache where the page is held and from
+*           the part otherwise. Waits up to EEPROM_BUSY_TIMEOUT ms for a
+*           page program in progress before reading the part.
+*
+* PreCondition: EEPROM_Initialize(), TIMER_SetConfiguration(), not
+*               called from an interrupt
+*
+* Input: uint16_t address - first byte
+*        void *data - destination
+*        uint16_t length - number of bytes
+*
+* Output: true if read, false if the range is outside the part, the
+*         part stayed busy or SPI1 is streaming
+*
+********************************************************************/
+bool EEPROM_Read(uint16_t address, void *data, uint16_t length);
+
+/*********************************************************************
+* Function: EEPROM_Write(uint16_t address, const void *data, uint16_t length);
+*
+* Overview: Writes bytes into the cache. Each touched page is read in
+*           once, and written back as a whole page by the 1 ms tick
+*           EEPROM_WRITE_BACK_DELAY ms after its last write, when it is
+*           evicted or on EEPROM_Flush(). Only blocks when a page has
+*           to be evicted or read in, for at most EEPROM_BUSY_TIMEOUT ms
+*           per page.
+*
+* PreCondition: EEPROM_Initialize(), TIMER_SetConfiguration(), not
+*               called from an interrupt
+*
+* Input: uint16_t address - first byte
+*        const void *data - source
+*        uint16_t length - number of bytes
+*
+* Output: true if cached, false if the range is outside the part, no
+*         cache line came free in time, a page could not be read in
+*         (SPI1 streaming) or the write back tick could not be started.
+*         Pages before the failing one are cached.
+*
+********************************************************************/
+bool EEPROM_Write(uint16_t address, const void *data, uint16_t length);
+
+/*********************************************************************
+* Function: EEPROM_Flush(void);
+*
+* Overview: Starts writing back every dirty page without waiting for
+*           the write back delay. Does not block; EEPROM_IsBusy() goes
+*           false once everything is programmed.
+*
+* PreCondition: EEPROM_Initialize(), TIMER_SetConfiguration()
+*
+* Input: none
+*
+* Output: false if the write back tick could not be requested
+*
+********************************************************************/
+bool EEPROM_Flush(void);
+
+/*********************************************************************
+* Function: EEPROM_IsBusy(void);
+*
+* Overview: Reports whether dirty pages or a page program are pending
+*
+* PreCondition: EEPROM_Initialize()
+*
+* Input: none
+*
+* Output: true until every write has been programmed
+*
+********************************************************************/
+bool EEPROM_IsBusy(void);
+
+/*********************************************************************
+* Function: EEPROM_StatisticsGet(EEPROM_STATISTICS *statistics);
+*
+* Overview: Copies the cache and program counters since
+*           EEPROM_Initialize(), consistently with the SPI1 interrupt
+*
+* PreCondition: EEPROM_Initialize()
+*
+* Input: EEPROM_STATISTICS *statistics - where to copy the counters
+*
+* Output: none
+*
+********************************************************************/
+void EEPROM_StatisticsGet(EEPROM_STATISTICS *statistics);
+
+#endif	/* EEPROM_H */
+
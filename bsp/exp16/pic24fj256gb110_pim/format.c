@@ -0,0 +1,161 @@
+/*
+ * File:   format.c
+ *
+ * Number conversion for the display and telemetry paths. The PIC24 has a
+ * hardware multiplier but only an iterative (18 cycle per step) divider,
+ * so scaling is done with Q-format reciprocals and decimal conversion with
+ * double dabble; nothing here divides.
+ */
+
+#include <xc.h>
+#include <stdbool.h>
+#include <format.h>
+
+/* 3300 / 1023 in Q13: 3.2258 * 8192 = 26426 */
+#define FORMAT_MV_PER_COUNT_Q13     26426
+#define FORMAT_Q13_SHIFT            13
+#define FORMAT_Q13_ROUND            (1UL << (FORMAT_Q13_SHIFT - 1))
+
+/* TC1047A transfer function */
+#define FORMAT_TC1047_OFFSET_MV     500
+
+/*********************************************************************
+* Function: FORMAT_CountsToMillivolts(uint16_t counts);
+*
+* Overview: Converts a 10-bit ADC result to millivolts
+*
+* PreCondition: none
+*
+* Input: uint16_t counts - ADC result, 0 to 1023
+*
+* Output: uint16_t - millivolts, 0 to 3300
+*
+********************************************************************/
+uint16_t FORMAT_CountsToMillivolts(uint16_t counts)
+{
+    return (uint16_t)((__builtin_muluu(counts, FORMAT_MV_PER_COUNT_Q13) + FORMAT_Q13_ROUND) >> FORMAT_Q13_SHIFT);
+}
+
+/*********************************************************************
+* Function: FORMAT_MillivoltsToDeciCelsius(uint16_t millivolts);
+*
+* Overview: Converts the TC1047A output to tenths of a degree Celsius
+*
+* PreCondition: none
+*
+* Input: uint16_t millivolts - sensor output
+*
+* Output: int16_t - temperature in 0.1 C steps
+*
+********************************************************************/
+int16_t FORMAT_MillivoltsToDeciCelsius(uint16_t millivolts)
+{
+    /* 10 mV per degree is exactly 1 mV per 0.1 degree */
+    return (int16_t)millivolts - FORMAT_TC1047_OFFSET_MV;
+}
+
+/*********************************************************************
+* Function: FORMAT_BinaryToBcd(uint16_t value);
+*
+* Overview: Converts a binary value to packed BCD (double dabble)
+*
+* PreCondition: none
+*
+* Input: uint16_t value - value to convert
+*
+* Output: uint32_t - 5 packed BCD digits
+*
+********************************************************************/
+uint32_t FORMAT_BinaryToBcd(uint16_t value)
+{
+    uint32_t bcd = 0;
+    uint8_t bit;
+    uint8_t shift;
+
+    for (bit = 0; bit < 16; bit++)
+    {
+        /* Any digit of 5 or more would pass 9 when doubled, add 3 first so
+         * the carry lands in the next digit */
+        for (shift = 0; shift < (FORMAT_BCD_DIGITS * 4); shift += 4)
+        {
+            if (((bcd >> shift) & 0x0F) >= 5)
+            {
+                bcd += 3UL << shift;
+            }
+        }
+
+        bcd = (bcd << 1) | (value >> 15);
+        value <<= 1;
+    }
+
+    return bcd;
+}
+
+/*********************************************************************
+* Function: FORMAT_Bcd2(char *buffer, uint8_t bcd);
+*
+* Overview: Writes two ASCII digits from a packed BCD byte
+*
+* PreCondition: none
+*
+* Input: char *buffer - destination, 2 characters
+*        uint8_t bcd - packed BCD byte
+*
+* Output: none
+*
+********************************************************************/
+void FORMAT_Bcd2(char *buffer, uint8_t bcd)
+{
+    buffer[0] = '0' + (bcd >> 4);
+    buffer[1] = '0' + (bcd & 0x0F);
+}
+
+/*********************************************************************
+* Function: FORMAT_Fixed(char *buffer, uint16_t value, uint8_t digits,
+*                        uint8_t decimals);
+*
+* Overview: Writes value as a right aligned fixed point decimal
+*
+* PreCondition: none
+*
+* Input: char *buffer - destination
+*        uint16_t value - value in units of 10^-decimals
+*        uint8_t digits - number of digits, at most FORMAT_BCD_DIGITS
+*        uint8_t decimals - digits after the point, less than digits
+*
+* Output: uint8_t - characters written
+*
+********************************************************************/
+uint8_t FORMAT_Fixed(char *buffer, uint16_t value, uint8_t digits, uint8_t decimals)
+{
+    uint32_t bcd = FORMAT_BinaryToBcd(value);
+    uint8_t written = 0;
+    uint8_t digit;
+    uint8_t nibble;
+    bool leading = true;
+
+    while (digits--)
+    {
+        nibble = (uint8_t)(bcd >> (digits * 4)) & 0x0F;
+
+        /* Blank leading zeros, but always keep the units digit */
+        if (leading && (nibble == 0) && (digits > decimals))
+        {
+            digit = ' ';
+        }
+        else
+        {
+            digit = '0' + nibble;
+            leading = false;
+        }
+
+        buffer[written++] = digit;
+
+        if ((decimals != 0) && (digits == decimals))
+        {
+            buffer[written++] = '.';
+        }
+    }
+
+    return written;
+}
@@ -0,0 +1,127 @@
+/* Microchip Technology Inc. and its subsidiaries.  You may use this software 
+ * and any derivatives exclusively with Microchip products. 
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES, WHETHER 
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED 
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A 
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION 
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION. 
+ *
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, 
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND 
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS 
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE 
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS 
+ * IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF 
+ * ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE 
+ * TERMS. 
+ */
+
+/* 
+ * File:   format.h
+ * Author: 
+ * Comments: Division free conversion and decimal formatting for display and telemetry
+ * Revision history: 
+ */
+
+// This is a guard condition so that contents of this file are not included
+// more than once.  
+#ifndef FORMAT_H
+#define	FORMAT_H
+
+#include <stdint.h>
+
+/* 10-bit ADC full scale against a 3.3 V reference, in millivolts */
+#define FORMAT_ADC_FULL_SCALE_MV    3300
+
+/* Digits produced by FORMAT_BinaryToBcd() for a 16-bit value */
+#define FORMAT_BCD_DIGITS           5
+
+/*********************************************************************
+* Function: FORMAT_CountsToMillivolts(uint16_t counts);
+*
+* Overview: Converts a 10-bit ADC result to millivolts by multiplying
+*           with the Q13 reciprocal of 1023/3300 (one hardware 16x16
+*           multiply and a shift). Within 1 mV of the exact result.
+*
+* PreCondition: none
+*
+* Input: uint16_t counts - ADC result, 0 to 1023
+*
+* Output: uint16_t - millivolts, 0 to 3300
+*
+********************************************************************/
+uint16_t FORMAT_CountsToMillivolts(uint16_t counts);
+
+/*********************************************************************
+* Function: FORMAT_MillivoltsToDeciCelsius(uint16_t millivolts);
+*
+* Overview: Converts the TC1047A output (500 mV at 0 C, 10 mV/C) to
+*           tenths of a degree Celsius
+*
+* PreCondition: none
+*
+* Input: uint16_t millivolts - sensor output
+*
+* Output: int16_t - temperature in 0.1 C steps
+*
+********************************************************************/
+int16_t FORMAT_MillivoltsToDeciCelsius(uint16_t millivolts);
+
+/*********************************************************************
+* Function: FORMAT_BinaryToBcd(uint16_t value);
+*
+* Overview: Converts a binary value to packed BCD with the double dabble
+*           (shift and add 3) algorithm. No division is used.
+*
+* PreCondition: none
+*
+* Input: uint16_t value - value to convert
+*
+* Output: uint32_t - 5 packed BCD digits, least significant in bits 3:0
+*
+********************************************************************/
+uint32_t FORMAT_BinaryToBcd(uint16_t value);
+
+/*********************************************************************
+* Function: FORMAT_Bcd2(char *buffer, uint8_t bcd);
+*
+* Overview: Writes two ASCII digits from a packed BCD byte, such as the
+*           RTCC time fields
+*
+* PreCondition: none
+*
+* Input: char *buffer - destination, 2 characters
+*        uint8_t bcd - packed BCD byte
+*
+* Output: none
+*
+********************************************************************/
+void FORMAT_Bcd2(char *buffer, uint8_t bcd);
+
+/*********************************************************************
+* Function: FORMAT_Fixed(char *buffer, uint16_t value, uint8_t digits,
+*                        uint8_t decimals);
+*
+* Overview: Writes value as a right aligned fixed point decimal. A '.'
+*           is inserted before the last decimals digits and leading zeros
+*           of the integer part are replaced by spaces. For example
+*           3300 with 4 digits and 3 decimals gives "3.300", and 253
+*           with 4 digits and 1 decimal gives " 25.3". Not terminated.
+*
+* PreCondition: none
+*
+* Input: char *buffer - destination, digits (+1 if decimals) characters
+*        uint16_t value - value in units of 10^-decimals
+*        uint8_t digits - number of digits, at most FORMAT_BCD_DIGITS
+*        uint8_t decimals - digits after the point, less than digits
+*
+* Output: uint8_t - characters written
+*
+********************************************************************/
+uint8_t FORMAT_Fixed(char *buffer, uint16_t value, uint8_t digits, uint8_t decimals);
+
+#endif	/* FORMAT_H */
+
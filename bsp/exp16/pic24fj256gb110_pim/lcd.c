@@ -23,6 +23,7 @@ CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
 #include <xc.h>
 #include <lcd.h>
 #include <stdint.h>
+#include <timer_1ms.h>
 
 /* Private Definitions ***********************************************/
 // Define a fast instruction execution time in terms of loop time
@@ -39,6 +40,10 @@ CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
 
 #define LCD_MAX_COLUMN      16
 
+// Background initialization, in 1ms ticks.  HD44780 needs > 40ms after
+// power-up, then up to 1.52ms for clear and return home
+#define LCD_POWER_UP_TICKS  50
+
 #define LCD_SendData(data) { PMADDR = 0x0001; PMDIN1 = data; LCD_Wait(LCD_F_INSTR); }
 #define LCD_SendCommand(command, delay) { PMADDR = 0x0000; PMDIN1 = command; LCD_Wait(delay); }
 #define LCD_COMMAND_CLEAR_SCREEN        0x01
@@ -52,7 +57,22 @@ CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
 #define LCD_COMMAND_ROW_0_HOME          0x80
 #define LCD_COMMAND_ROW_1_HOME          0xC0
 
+/* Private Types *****************************************************/
+typedef enum
+{
+    LCD_STATE_OFF ,
+    LCD_STATE_STARTING ,
+    LCD_STATE_READY
+} LCD_STATE ;
+
+typedef struct
+{
+    uint8_t command ;
+    uint8_t ticks ;             // wait after the command
+} LCD_INIT_STEP ;
+
 /* Private Functions *************************************************/
+static void LCD_InitializeTick ( void ) ;
 static void LCD_CarriageReturn ( void ) ;
 static void LCD_ShiftCursorLeft ( void ) ;
 static void LCD_ShiftCursorRight ( void ) ;
@@ -63,6 +83,21 @@ static void LCD_Wait ( unsigned int ) ;
 /* Private variables ************************************************/
 static uint8_t row ;
 static uint8_t column ;
+static volatile LCD_STATE lcdState = LCD_STATE_OFF ;
+static uint8_t lcdStep ;
+static uint8_t lcdTicks ;
+
+/* Same commands as LCD_Initialize() and LCD_ClearScreen() */
+static const LCD_INIT_STEP lcdInitSteps[] =
+{
+    { LCD_COMMAND_SET_MODE_8_BIT ,  5 } ,
+    { LCD_COMMAND_CURSOR_OFF ,      1 } ,
+    { LCD_COMMAND_ENTER_DATA_MODE , 2 } ,
+    { LCD_COMMAND_CLEAR_SCREEN ,    2 } ,
+    { LCD_COMMAND_RETURN_HOME ,     2 }
+} ;
+
+#define LCD_INIT_STEPS      ( sizeof ( lcdInitSteps ) / sizeof ( lcdInitSteps[0] ) )
 /*********************************************************************
  * Function: bool LCD_Initialize(void);
  *
@@ -78,6 +113,18 @@ static uint8_t column ;
  ********************************************************************/
 bool LCD_Initialize ( void )
 {
+    if (lcdState == LCD_STATE_STARTING)
+    {
+        while (lcdState != LCD_STATE_READY)
+        {
+        }
+    }
+
+    if (lcdState == LCD_STATE_READY)
+    {
+        return true ;
+    }
+
     PMMODE = 0x03ff ;
     // Enable PMP Module, No Address & Data Muxing,
     // Enable RdWr Port, Enable Enb Port, No Chip Select,
@@ -95,10 +142,64 @@ bool LCD_Initialize ( void )
 
     LCD_ClearScreen ( ) ;
 
+    lcdState = LCD_STATE_READY ;
+
+    return true ;
+}
+/*********************************************************************
+ * Function: bool LCD_InitializeStart(void);
+ *
+ * Overview: Starts initializing the LCD from the 1ms tick
+ *
+ * PreCondition: TIMER_SetConfiguration() has been called
+ *
+ * Input: None
+ *
+ * Output: true if started, false if no tick handler slot is free
+ *
+ ********************************************************************/
+bool LCD_InitializeStart ( void )
+{
+    if (lcdState != LCD_STATE_OFF)
+    {
+        return true ;
+    }
+
+    // Same PMP setup as LCD_Initialize()
+    PMMODE = 0x03ff ;
+    PMCON = 0x8383 ;
+    PMAEN = 0x0001 ;
+
+    lcdStep = 0 ;
+    lcdTicks = LCD_POWER_UP_TICKS ;
+    lcdState = LCD_STATE_STARTING ;
+
+    if (TIMER_RequestTick ( LCD_InitializeTick , 1 ) == false)
+    {
+        lcdState = LCD_STATE_OFF ;
+        return false ;
+    }
+
     return true ;
 }
 /*********************************************************************
- * Function: void LCD_PutString(char* inputString, uint16_t length);
+ * Function: bool LCD_IsReady(void);
+ *
+ * Overview: Reports whether the LCD has finished initializing
+ *
+ * PreCondition: None
+ *
+ * Input: None
+ *
+ * Output: true once the LCD accepts characters
+ *
+ ********************************************************************/
+bool LCD_IsReady ( void )
+{
+    return (lcdState == LCD_STATE_READY) ;
+}
+/*********************************************************************
+ * Function: void LCD_PutString(const char* inputString, uint16_t length);
  *
  * Overview: Puts a string on the LCD screen.  Unsupported characters will be
  *           discarded.  May block or throw away characters is LCD is not ready
@@ -108,13 +209,13 @@ bool LCD_Initialize ( void )
  *
  * PreCondition: already initialized via LCD_Initialize()
  *
- * Input: char* - string to print
+ * Input: const char* - string to print
  *        uint16_t - length of string to print
  *
  * Output: None
  *
  ********************************************************************/
-void LCD_PutString ( char* inputString , uint16_t length )
+void LCD_PutString ( const char* inputString , uint16_t length )
 {
     while (length--)
     {
@@ -216,6 +317,42 @@ void LCD_ClearScreen ( void )
 /* Private Functions ***********************************************/
 /*******************************************************************/
 /*******************************************************************/
+/*********************************************************************
+ * Function: static void LCD_InitializeTick(void)
+ *
+ * Overview: One step of the background initialization.  Counts down
+ *           the wait of the previous step, then writes the next command
+ *           without waiting for it; the tick period is the wait.
+ *
+ * PreCondition: Called from the Timer 2 interrupt
+ *
+ * Input: None
+ *
+ * Output: None
+ *
+ ********************************************************************/
+static void LCD_InitializeTick ( void )
+{
+    if (--lcdTicks != 0)
+    {
+        return ;
+    }
+
+    if (lcdStep < LCD_INIT_STEPS)
+    {
+        PMADDR = 0x0000 ;
+        PMDIN1 = lcdInitSteps[lcdStep].command ;
+        lcdTicks = lcdInitSteps[lcdStep].ticks ;
+        lcdStep++ ;
+        return ;
+    }
+
+    row = 0 ;
+    column = 0 ;
+    lcdState = LCD_STATE_READY ;
+
+    TIMER_CancelTick ( LCD_InitializeTick ) ;
+}
 /*********************************************************************
  * Function: static void LCD_CarriageReturn(void)
  *
@@ -27,9 +27,11 @@ CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
 * Function: bool LCD_Initialize(void);
 *
 * Overview: Initializes the LCD screen.  Can take several hundred
-*           milliseconds.
+*           milliseconds.  If LCD_InitializeStart() has been called this
+*           waits for the background initialization to finish instead.
 *
-* PreCondition: none
+* PreCondition: none, not called from an interrupt once
+*               LCD_InitializeStart() has been called
 *
 * Input: None
 *
@@ -39,7 +41,39 @@ CONSEQUENTIAL DAMAGES, FOR ANY REASON WHATSOEVER.
 bool LCD_Initialize(void);
 
 /*********************************************************************
-* Function: void LCD_PutString(char* inputString, uint16_t length);
+* Function: bool LCD_InitializeStart(void);
+*
+* Overview: Starts initializing the LCD in the background.  The power-up
+*           wait and the setup commands run from the 1ms tick, so the
+*           caller does not wait the several hundred milliseconds
+*           LCD_Initialize() takes.  Poll LCD_IsReady() before printing.
+*
+* PreCondition: TIMER_SetConfiguration() has been called
+*
+* Input: None
+*
+* Output: true if started (or already started), false if no tick
+*         handler slot is free
+*
+********************************************************************/
+bool LCD_InitializeStart(void);
+
+/*********************************************************************
+* Function: bool LCD_IsReady(void);
+*
+* Overview: Reports whether the LCD has finished initializing
+*
+* PreCondition: None
+*
+* Input: None
+*
+* Output: true once the LCD accepts characters
+*
+********************************************************************/
+bool LCD_IsReady(void);
+
+/*********************************************************************
+* Function: void LCD_PutString(const char* inputString, uint16_t length);
 *
 * Overview: Puts a string on the LCD screen.  Unsupported characters will be
 *           discarded.  May block or throw away characters is LCD is not ready
@@ -49,13 +83,13 @@ bool LCD_Initialize(void);
 *
 * PreCondition: already initialized via LCD_Initialize()
 *
-* Input: char* - string to print
+* Input: const char* - string to print
 *        uint16_t - length of string to print
 *
 * Output: None
 *
 ********************************************************************/
-void LCD_PutString(char* inputString, uint16_t length);
+void LCD_PutString(const char* inputString, uint16_t length);
 
 /*********************************************************************
 * Function: void LCD_PutChar(char);
@@ -23,30 +23,42 @@
 #include <xc.h>
 #include <leds.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+// D3 - D10 are wired to RA0 - RA7, so bit n of an LED mask is LATA bit n
+#define LED_LAT         LATA
+#define LED_TRIS        TRISA               //RA7 overlaps with S5
+
+// Bit angle modulation: bit plane n is shown for LED_BAM_UNIT_CYCLES << n
+// instruction cycles, so 8-bit brightness needs 8 Timer 1 interrupts per
+// period (255 * 128 cycles = 8.16ms, ~122Hz at FCY = 4MHz). The shortest
+// slot must be longer than the ISR from the T1IF event to its PR1 write,
+// or the timer rolls over on the old period and the low planes come out
+// wrong. Counted from the instruction timings: ~6 cycles latency, ~20 for
+// the auto_psv prologue and epilogue, ~30 for LED_SetMask() and the PR1
+// update, so ~60 cycles before any higher priority interrupt is added.
+// The tick shares priority 1 and the UARTs, SPI1 and the bit bang timer
+// preempt it, so a late ISR can still miss the slot; it then restarts the
+// timer rather than letting it run to 0xFFFF (a ~16ms flash).
+#define LED_BAM_BITS            8
+#define LED_BAM_UNIT_CYCLES     128
+#define LED_BAM_ISR_CYCLES      60
+
+#if (LED_BAM_UNIT_CYCLES < (2 * LED_BAM_ISR_CYCLES))
+#error "LED_BAM_UNIT_CYCLES leaves no margin over the Timer 1 interrupt"
+#endif
+
+// D3 (RA0) is shared with the bit bang UART, so the engine never drives it
+#define LED_BAM_EXCLUDED        LED_MASK ( LED_D3 )
+
+#define LED_BAM_TIMER_ON        0x8000      // Timer 1 on, internal clock, 1:1
+#define LED_BAM_PRIORITY        1
+
+/* Private variables ************************************************/
+static volatile uint8_t bamPlane[LED_BAM_BITS] ;
+static volatile uint8_t bamMask ;
+static uint8_t bamBit ;
 
-#define LED_D3_LAT      LATAbits.LATA0
-#define LED_D4_LAT      LATAbits.LATA1
-#define LED_D5_LAT      LATAbits.LATA2
-#define LED_D6_LAT      LATAbits.LATA3
-#define LED_D7_LAT      LATAbits.LATA4
-#define LED_D8_LAT      LATAbits.LATA5
-#define LED_D9_LAT      LATAbits.LATA6
-#define LED_D10_LAT     LATAbits.LATA7      //Overlaps with S5
-
-#define LED_D3_TRIS     TRISAbits.TRISA0
-#define LED_D4_TRIS     TRISAbits.TRISA1
-#define LED_D5_TRIS     TRISAbits.TRISA2
-#define LED_D6_TRIS     TRISAbits.TRISA3
-#define LED_D7_TRIS     TRISAbits.TRISA4
-#define LED_D8_TRIS     TRISAbits.TRISA5
-#define LED_D9_TRIS     TRISAbits.TRISA6
-#define LED_D10_TRIS    TRISAbits.TRISA7    //Overlaps with S5
-
-#define LED_ON  1
-#define LED_OFF 0
-
-#define INPUT  1
-#define OUTPUT 0
 /*********************************************************************
  * Function: void LED_On(LED led);
  *
@@ -65,42 +77,9 @@
  ********************************************************************/
 void LED_On ( LED led )
 {
-    switch (led)
+    if (led != LED_NONE)
     {
-        case LED_D3:
-            LED_D3_LAT = LED_ON ;
-            break ;
-
-        case LED_D4:
-            LED_D4_LAT = LED_ON ;
-            break ;
-
-        case LED_D5:
-            LED_D5_LAT = LED_ON ;
-            break ;
-
-        case LED_D6:
-            LED_D6_LAT = LED_ON ;
-            break ;
-
-        case LED_D7:
-            LED_D7_LAT = LED_ON ;
-            break ;
-
-        case LED_D8:
-            LED_D8_LAT = LED_ON ;
-            break ;
-
-        case LED_D9:
-            LED_D9_LAT = LED_ON ;
-            break ;
-
-        case LED_D10:
-            LED_D10_LAT = LED_ON ;
-            break ;
-
-        case LED_NONE:
-            break ;
+        LED_SetMask ( LED_MASK ( led ) , LED_MASK_ALL ) ;
     }
 }
 /*********************************************************************
@@ -121,42 +100,9 @@ void LED_On ( LED led )
  ********************************************************************/
 void LED_Off ( LED led )
 {
-    switch (led)
+    if (led != LED_NONE)
     {
-        case LED_D3:
-            LED_D3_LAT = LED_OFF ;
-            break ;
-
-        case LED_D4:
-            LED_D4_LAT = LED_OFF ;
-            break ;
-
-        case LED_D5:
-            LED_D5_LAT = LED_OFF ;
-            break ;
-
-        case LED_D6:
-            LED_D6_LAT = LED_OFF ;
-            break ;
-
-        case LED_D7:
-            LED_D7_LAT = LED_OFF ;
-            break ;
-
-        case LED_D8:
-            LED_D8_LAT = LED_OFF ;
-            break ;
-
-        case LED_D9:
-            LED_D9_LAT = LED_OFF ;
-            break ;
-
-        case LED_D10:
-            LED_D10_LAT = LED_OFF ;
-            break ;
-
-        case LED_NONE:
-            break ;
+        LED_SetMask ( LED_MASK ( led ) , 0 ) ;
     }
 }
 /*********************************************************************
@@ -177,42 +123,13 @@ void LED_Off ( LED led )
  ********************************************************************/
 void LED_Toggle ( LED led )
 {
-    switch (led)
-    {
-        case LED_D3:
-            LED_D3_LAT ^= 1 ;
-            break ;
-
-        case LED_D4:
-            LED_D4_LAT ^= 1 ;
-            break ;
-
-        case LED_D5:
-            LED_D5_LAT ^= 1 ;
-            break ;
-
-        case LED_D6:
-            LED_D6_LAT ^= 1 ;
-            break ;
-
-        case LED_D7:
-            LED_D7_LAT ^= 1 ;
-            break ;
-
-        case LED_D8:
-            LED_D8_LAT ^= 1 ;
-            break ;
+    uint16_t ipl ;
 
-        case LED_D9:
-            LED_D9_LAT ^= 1 ;
-            break ;
-
-        case LED_D10:
-            LED_D10_LAT ^= 1 ;
-            break ;
-
-        case LED_NONE:
-            break ;
+    if (led != LED_NONE)
+    {
+        SET_AND_SAVE_CPU_IPL ( ipl , 7 ) ;
+        LED_LAT ^= LED_MASK ( led ) ;
+        RESTORE_CPU_IPL ( ipl ) ;
     }
 }
 /*********************************************************************
@@ -233,36 +150,12 @@ void LED_Toggle ( LED led )
  ********************************************************************/
 bool LED_Get ( LED led )
 {
-    switch (led)
+    if (led == LED_NONE)
     {
-        case LED_D3:
-            return ( ( LED_D3_LAT == LED_ON ) ? true : false ) ;
-
-        case LED_D4:
-            return ( ( LED_D4_LAT == LED_ON ) ? true : false ) ;
-
-        case LED_D5:
-            return ( ( LED_D5_LAT == LED_ON ) ? true : false ) ;
-
-        case LED_D6:
-            return ( ( LED_D6_LAT == LED_ON ) ? true : false ) ;
-
-        case LED_D7:
-            return ( ( LED_D7_LAT == LED_ON ) ? true : false ) ;
-
-        case LED_D8:
-            return ( ( LED_D8_LAT == LED_ON ) ? true : false ) ;
-
-        case LED_D9:
-            return ( ( LED_D9_LAT == LED_ON ) ? true : false ) ;
-
-        case LED_D10:
-            return ( ( LED_D10_LAT == LED_ON ) ? true : false ) ;
-
-        case LED_NONE:
-            return false ;
+        return false ;
     }
-    return false ;
+
+    return ( ( LED_LAT & LED_MASK ( led ) ) != 0 ) ;
 }
 /*********************************************************************
  * Function: void LED_Enable(LED led);
@@ -281,42 +174,161 @@ bool LED_Get ( LED led )
  ********************************************************************/
 void LED_Enable ( LED led )
 {
-    switch (led)
+    uint16_t ipl ;
+
+    if (led != LED_NONE)
+    {
+        SET_AND_SAVE_CPU_IPL ( ipl , 7 ) ;
+        LED_TRIS &= ~LED_MASK ( led ) ;
+        RESTORE_CPU_IPL ( ipl ) ;
+    }
+}
+/*********************************************************************
+ * Function: void LED_SetMask(uint8_t mask, uint8_t value);
+ *
+ * Overview: Sets every LED selected by mask to the matching bit of
+ *           value with a single write to LATA. Bit 0 is D3, bit 7 is
+ *           D10 (see LED_MASK()).
+ *
+ * PreCondition: LEDs configured via LED_Enable()
+ *
+ * Input: uint8_t mask - LEDs to update
+ *        uint8_t value - new on (1) / off (0) state for those LEDs
+ *
+ * Output: none
+ *
+ ********************************************************************/
+void LED_SetMask ( uint8_t mask , uint8_t value )
+{
+    uint16_t ipl ;
+
+    // RA0 is shared with the bit bang UART, so the read-modify-
+    // write must not be split by an interrupt that drives the same port
+    SET_AND_SAVE_CPU_IPL ( ipl , 7 ) ;
+    LED_LAT = ( LED_LAT & ~( uint16_t ) mask ) | ( value & mask ) ;
+    RESTORE_CPU_IPL ( ipl ) ;
+}
+/*********************************************************************
+ * Function: void LED_BrightnessSet(LED led, uint8_t level);
+ *
+ * Overview: Sets the brightness of an LED driven by the bit angle
+ *           modulation engine. The new level takes effect from the next
+ *           bit plane shown.
+ *
+ * PreCondition: none
+ *
+ * Input: LED led - LED to change
+ *        uint8_t level - 0 (off) to 255 (fully on)
+ *
+ * Output: none
+ *
+ ********************************************************************/
+void LED_BrightnessSet ( LED led , uint8_t level )
+{
+    uint8_t bit ;
+    uint8_t mask ;
+
+    if (led == LED_NONE)
     {
-        case LED_D3:
-            LED_D3_TRIS = OUTPUT ;
-            break ;
+        return ;
+    }
 
-        case LED_D4:
-            LED_D4_TRIS = OUTPUT ;
-            break ;
+    mask = LED_MASK ( led ) ;
 
-        case LED_D5:
-            LED_D5_TRIS = OUTPUT ;
-            break ;
+    for (bit = 0 ; bit < LED_BAM_BITS ; bit++)
+    {
+        if (level & ( 1 << bit ))
+        {
+            bamPlane[bit] |= mask ;
+        }
+        else
+        {
+            bamPlane[bit] &= ~mask ;
+        }
+    }
+}
+/*********************************************************************
+ * Function: void LED_BrightnessEnable(uint8_t mask);
+ *
+ * Overview: Starts the bit angle modulation engine on Timer 1 for the
+ *           LEDs selected by mask. LEDs outside the mask keep working
+ *           through LED_On()/LED_Off()/LED_SetMask(). D3 is left out of
+ *           the mask because RA0 has other users.
+ *
+ * PreCondition: LEDs configured via LED_Enable()
+ *
+ * Input: uint8_t mask - LEDs driven by the engine
+ *
+ * Output: none
+ *
+ ********************************************************************/
+void LED_BrightnessEnable ( uint8_t mask )
+{
+    IEC0bits.T1IE = 0 ;
+    T1CON = 0 ;
 
-        case LED_D6:
-            LED_D6_TRIS = OUTPUT ;
-            break ;
+    bamMask = mask & ~LED_BAM_EXCLUDED ;
+    bamBit = 0 ;
 
-        case LED_D7:
-            LED_D7_TRIS = OUTPUT ;
-            break ;
+    TMR1 = 0 ;
+    PR1 = LED_BAM_UNIT_CYCLES - 1 ;
 
-        case LED_D8:
-            LED_D8_TRIS = OUTPUT ;
-            break ;
+    IPC0bits.T1IP = LED_BAM_PRIORITY ;
+    IFS0bits.T1IF = 0 ;
+    IEC0bits.T1IE = 1 ;
 
-        case LED_D9:
-            LED_D9_TRIS = OUTPUT ;
-            break ;
+    T1CON = LED_BAM_TIMER_ON ;
+}
+/*********************************************************************
+ * Function: void LED_BrightnessDisable(void);
+ *
+ * Overview: Stops the bit angle modulation engine and turns off the
+ *           LEDs it was driving.
+ *
+ * PreCondition: none
+ *
+ * Input: none
+ *
+ * Output: none
+ *
+ ********************************************************************/
+void LED_BrightnessDisable ( void )
+{
+    T1CON = 0 ;
+    IEC0bits.T1IE = 0 ;
+    IFS0bits.T1IF = 0 ;
 
-        case LED_D10:
-            LED_D10_TRIS = OUTPUT ;
-            break ;
+    LED_SetMask ( bamMask , 0 ) ;
+    bamMask = 0 ;
+}
+/*********************************************************************
+ * Function: void _T1Interrupt(void)
+ *
+ * Overview: Shows the next bit plane and loads its weighted duration.
+ *           The timer has just rolled over, so the new period applies to
+ *           the plane being shown.
+ *
+ * PreCondition: LED_BrightnessEnable()
+ *
+ * Input: none
+ *
+ * Output: none
+ *
+ ********************************************************************/
+void __attribute__ ( ( __interrupt__ , auto_psv ) ) _T1Interrupt ( void )
+{
+    LED_SetMask ( bamMask , bamPlane[bamBit] ) ;
+    PR1 = ( LED_BAM_UNIT_CYCLES << bamBit ) - 1 ;
 
-        case LED_NONE:
-            break ;
+    // Too late for the new period: the plane runs a little long instead
+    // of for a whole 16 bit timer wrap
+    if ( TMR1 >= PR1 )
+    {
+        TMR1 = 0 ;
     }
+
+    bamBit = ( bamBit + 1 ) & ( LED_BAM_BITS - 1 ) ;
+
+    IFS0bits.T1IF = 0 ;
 }
 
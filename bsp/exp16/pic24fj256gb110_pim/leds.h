@@ -24,6 +24,7 @@
 #define LEDS_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 /** Type defintions *********************************/
 typedef enum
@@ -41,6 +42,10 @@ typedef enum
 
 #define LED_COUNT 8
 
+/* Bit of the LED bank mask used by LED_SetMask(), bit 0 is D3 */
+#define LED_MASK(led) ((uint8_t)(1 << ((led) - LED_D3)))
+#define LED_MASK_ALL  0xFF
+
 /*********************************************************************
 * Function: void LED_On(LED led);
 *
@@ -130,4 +135,66 @@ bool LED_Get(LED led);
 ********************************************************************/
 void LED_Enable(LED led);
 
+/*********************************************************************
+* Function: void LED_SetMask(uint8_t mask, uint8_t value);
+*
+* Overview: Sets every LED selected by mask to the matching bit of
+*           value with a single write to the LED port.
+*
+* PreCondition: LEDs configured via LED_Enable()
+*
+* Input: uint8_t mask - LEDs to update, built from LED_MASK()
+*        uint8_t value - new on (1) / off (0) state for those LEDs
+*         i.e. - LED_SetMask(LED_MASK(LED_D3) | LED_MASK(LED_D4), 0x01);
+*
+* Output: none
+*
+********************************************************************/
+void LED_SetMask(uint8_t mask, uint8_t value);
+
+/*********************************************************************
+* Function: void LED_BrightnessSet(LED led, uint8_t level);
+*
+* Overview: Sets the brightness of an LED driven by the bit angle
+*           modulation engine
+*
+* PreCondition: none
+*
+* Input: LED led - LED to change
+*        uint8_t level - 0 (off) to 255 (fully on)
+*
+* Output: none
+*
+********************************************************************/
+void LED_BrightnessSet(LED led, uint8_t level);
+
+/*********************************************************************
+* Function: void LED_BrightnessEnable(uint8_t mask);
+*
+* Overview: Starts the bit angle modulation engine (Timer 1) for the
+*           LEDs selected by mask. D3 is never driven by the engine.
+*
+* PreCondition: LEDs configured via LED_Enable()
+*
+* Input: uint8_t mask - LEDs driven by the engine, built from LED_MASK()
+*
+* Output: none
+*
+********************************************************************/
+void LED_BrightnessEnable(uint8_t mask);
+
+/*********************************************************************
+* Function: void LED_BrightnessDisable(void);
+*
+* Overview: Stops the bit angle modulation engine and turns its LEDs off
+*
+* PreCondition: none
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+void LED_BrightnessDisable(void);
+
 #endif //LEDS_H
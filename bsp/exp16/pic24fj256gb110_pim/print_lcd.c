@@ -0,0 +1,518 @@
+/*
+ * File:   print_lcd.c
+ *
+ * Formatted print engine with selectable output sinks (LCD, the UART1
+ * transmit queue or a RAM buffer). Numbers are converted with repeated
+ * subtraction of powers of ten, so neither libc printf nor the software
+ * divide routines are linked in.
+ */
+
+#include <xc.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <print_lcd.h>
+#include <uart.h>
+
+/* Digits in the largest 32-bit value, 4294967295 */
+#define PRINT_MAX_DIGITS        10
+#define PRINT_MAX_DECIMALS      (PRINT_MAX_DIGITS - 1)
+
+static const uint32_t printPowersOfTen[PRINT_MAX_DIGITS] =
+{
+    1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+    10000UL, 1000UL, 100UL, 10UL, 1UL
+};
+
+static PRINT_CONFIGURATION printConfiguration = PRINT_CONFIGURATION_LCD;
+static bool printLcdReady;
+static char *printBuffer;
+static uint16_t printBufferSize;
+static uint16_t printBufferLength;
+
+static void PRINT_Emit(char character);
+static void PRINT_Pad(char padding, uint8_t count);
+static void PRINT_Decimal(uint32_t value, bool negative, uint8_t width, uint8_t decimals, bool zeroPad);
+static void PRINT_Hex(uint32_t value, uint8_t width, bool zeroPad, bool upperCase);
+
+/*********************************************************************
+* Function: bool PRINT_SetConfiguration(PRINT_CONFIGURATION configuration);
+*
+* Overview: Selects the output sink
+*
+* PreCondition: UART sink: UART_Initialize().  Buffer sink: PRINT_BufferSet().
+*
+* Input: configuration - the print configuration to use
+*
+* Output: true if the sink is available
+*
+********************************************************************/
+bool PRINT_SetConfiguration(PRINT_CONFIGURATION configuration)
+{
+    switch (configuration)
+    {
+        case PRINT_CONFIGURATION_LCD:
+            if (!printLcdReady)
+            {
+                printLcdReady = LCD_Initialize();
+            }
+            if (!printLcdReady)
+            {
+                return false;
+            }
+            break;
+
+        case PRINT_CONFIGURATION_UART:
+            break;
+
+        case PRINT_CONFIGURATION_BUFFER:
+            if (printBuffer == NULL)
+            {
+                return false;
+            }
+            break;
+
+        default:
+            return false;
+    }
+
+    printConfiguration = configuration;
+    return true;
+}
+
+/*********************************************************************
+* Function: PRINT_CONFIGURATION PRINT_GetConfiguration(void)
+*
+* Overview: Returns the sink currently selected
+*
+* PreCondition: none
+*
+* Input: None
+*
+* Output: the current print configuration
+*
+********************************************************************/
+PRINT_CONFIGURATION PRINT_GetConfiguration(void)
+{
+    return printConfiguration;
+}
+
+/*********************************************************************
+* Function: void PRINT_BufferSet(char* buffer, uint16_t size)
+*
+* Overview: Sets and empties the RAM buffer sink
+*
+* PreCondition: none
+*
+* Input: char* buffer - destination buffer
+*        uint16_t size - buffer size in bytes
+*
+* Output: None
+*
+********************************************************************/
+void PRINT_BufferSet(char* buffer, uint16_t size)
+{
+    printBuffer = buffer;
+    printBufferSize = size;
+    printBufferLength = 0;
+
+    if ((buffer != NULL) && (size != 0))
+    {
+        buffer[0] = 0;
+    }
+}
+
+/*********************************************************************
+* Function: uint16_t PRINT_BufferLength(void)
+*
+* Overview: Returns the number of characters in the RAM buffer
+*
+* PreCondition: PRINT_BufferSet()
+*
+* Input: None
+*
+* Output: uint16_t - characters written since PRINT_BufferSet()
+*
+********************************************************************/
+uint16_t PRINT_BufferLength(void)
+{
+    return printBufferLength;
+}
+
+/*********************************************************************
+* Function: void PRINT_String(const char* string, uint16_t length)
+*
+* Overview: Prints a string until a null terminator is reached or the
+*           specified string length is printed.
+*
+* PreCondition: none
+*
+* Input: const char* string - the string to print.
+*        uint16_t length - the length of the string.
+*
+* Output: None
+*
+********************************************************************/
+void PRINT_String(const char* string, uint16_t length)
+{
+    while (length-- && (*string != 0))
+    {
+        PRINT_Emit(*string++);
+    }
+}
+
+/*********************************************************************
+* Function: void PRINT_Char(char charToPrint)
+*
+* Overview: Prints a character
+*
+* PreCondition: none
+*
+* Input: char charToPrint - the character to print
+*
+* Output: None
+*
+********************************************************************/
+void PRINT_Char(char charToPrint)
+{
+    PRINT_Emit(charToPrint);
+}
+
+/*********************************************************************
+* Function: void PRINT_Formatted(const char* format, ...)
+*
+* Overview: Prints a formatted string, see print_lcd.h for conversions
+*
+* PreCondition: none
+*
+* Input: const char* format - format string
+*        ... - arguments
+*
+* Output: None
+*
+********************************************************************/
+void PRINT_Formatted(const char* format, ...)
+{
+    va_list arguments;
+    const char *string;
+    uint32_t value;
+    int32_t signedValue;
+    uint8_t width;
+    uint8_t decimals;
+    uint8_t length;
+    bool zeroPad;
+    bool isLong;
+    char character;
+
+    va_start(arguments, format);
+
+    while ((character = *format++) != 0)
+    {
+        if (character != '%')
+        {
+            PRINT_Emit(character);
+            continue;
+        }
+
+        zeroPad = false;
+        width = 0;
+        decimals = 0;
+        isLong = false;
+
+        if (*format == '0')
+        {
+            zeroPad = true;
+            format++;
+        }
+        while ((*format >= '0') && (*format <= '9'))
+        {
+            width = (width * 10) + (*format++ - '0');
+        }
+        if (*format == '.')
+        {
+            format++;
+            while ((*format >= '0') && (*format <= '9'))
+            {
+                decimals = (decimals * 10) + (*format++ - '0');
+            }
+            if (decimals > PRINT_MAX_DECIMALS)
+            {
+                decimals = PRINT_MAX_DECIMALS;
+            }
+        }
+        if (*format == 'l')
+        {
+            isLong = true;
+            format++;
+        }
+
+        switch (character = *format++)
+        {
+            case 'd':
+                signedValue = isLong ? va_arg(arguments, long) : va_arg(arguments, int);
+                value = (signedValue < 0) ? -(uint32_t)signedValue : (uint32_t)signedValue;
+                PRINT_Decimal(value, (signedValue < 0), width, decimals, zeroPad);
+                break;
+
+            case 'u':
+                value = isLong ? va_arg(arguments, unsigned long) : va_arg(arguments, unsigned int);
+                PRINT_Decimal(value, false, width, decimals, zeroPad);
+                break;
+
+            case 'x':
+            case 'X':
+                value = isLong ? va_arg(arguments, unsigned long) : va_arg(arguments, unsigned int);
+                PRINT_Hex(value, width, zeroPad, (character == 'X'));
+                break;
+
+            case 's':
+                string = va_arg(arguments, const char *);
+                for (length = 0; (length < width) && (string[length] != 0); length++)
+                {
+                }
+                PRINT_Pad(' ', width - length);
+                while (*string != 0)
+                {
+                    PRINT_Emit(*string++);
+                }
+                break;
+
+            case 'c':
+                PRINT_Emit((char)va_arg(arguments, int));
+                break;
+
+            case 0:
+                // format ended inside a conversion
+                format--;
+                break;
+
+            default:
+                // %% and unknown conversions print the character itself
+                PRINT_Emit(character);
+                break;
+        }
+    }
+
+    va_end(arguments);
+}
+
+/*********************************************************************
+* Function: void PRINT_ClearStreen()
+*
+* Overview: Clears the screen, or empties the RAM buffer
+*
+* PreCondition: none
+*
+* Input: None
+*
+* Output: None
+*
+********************************************************************/
+void PRINT_ClearScreen(void)
+{
+    switch (printConfiguration)
+    {
+        case PRINT_CONFIGURATION_LCD:
+            LCD_ClearScreen();
+            break;
+
+        case PRINT_CONFIGURATION_BUFFER:
+            PRINT_BufferSet(printBuffer, printBufferSize);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*********************************************************************
+* Function: void PRINT_CursorEnable(bool enable)
+*
+* Overview: Enables/disables the cursor (LCD sink only)
+*
+* PreCondition: None
+*
+* Input: bool - specifies if the cursor should be on or off
+*
+* Output: None
+*
+********************************************************************/
+void PRINT_CursorEnable(bool enable)
+{
+    if (printConfiguration == PRINT_CONFIGURATION_LCD)
+    {
+        LCD_CursorEnable(enable);
+    }
+}
+
+/*******************************************************************/
+/*******************************************************************/
+/* Private Functions ***********************************************/
+/*******************************************************************/
+/*******************************************************************/
+/*********************************************************************
+* Function: static void PRINT_Emit(char character)
+*
+* Overview: Sends one character to the selected sink.  The buffer sink
+*           drops characters once full and stays null terminated.
+*
+* PreCondition: none
+*
+* Input: char character - character to output
+*
+* Output: None
+*
+********************************************************************/
+static void PRINT_Emit(char character)
+{
+    switch (printConfiguration)
+    {
+        case PRINT_CONFIGURATION_UART:
+            UART_PutChar((uint8_t)character);
+            break;
+
+        case PRINT_CONFIGURATION_BUFFER:
+            if ((uint16_t)(printBufferLength + 1) < printBufferSize)
+            {
+                printBuffer[printBufferLength++] = character;
+                printBuffer[printBufferLength] = 0;
+            }
+            break;
+
+        default:
+            LCD_PutChar(character);
+            break;
+    }
+}
+
+/*********************************************************************
+* Function: static void PRINT_Pad(char padding, uint8_t count)
+*
+* Overview: Outputs count copies of a padding character
+*
+* PreCondition: none
+*
+* Input: char padding - character to repeat
+*        uint8_t count - repeat count
+*
+* Output: None
+*
+********************************************************************/
+static void PRINT_Pad(char padding, uint8_t count)
+{
+    while (count--)
+    {
+        PRINT_Emit(padding);
+    }
+}
+
+/*********************************************************************
+* Function: static void PRINT_Decimal(uint32_t value, bool negative,
+*                   uint8_t width, uint8_t decimals, bool zeroPad)
+*
+* Overview: Prints a magnitude and sign as a (fixed point) decimal
+*
+* PreCondition: none
+*
+* Input: uint32_t value - magnitude
+*        bool negative - print a leading '-'
+*        uint8_t width - minimum field width
+*        uint8_t decimals - digits after the decimal point
+*        bool zeroPad - pad with zeros instead of spaces
+*
+* Output: None
+*
+********************************************************************/
+static void PRINT_Decimal(uint32_t value, bool negative, uint8_t width, uint8_t decimals, bool zeroPad)
+{
+    char digits[PRINT_MAX_DIGITS];
+    uint8_t count = 0;
+    uint8_t length;
+    uint8_t i;
+    char digit;
+
+    for (i = 0; i < PRINT_MAX_DIGITS; i++)
+    {
+        digit = '0';
+        while (value >= printPowersOfTen[i])
+        {
+            value -= printPowersOfTen[i];
+            digit++;
+        }
+
+        /* Skip leading zeros but keep the units digit and every digit
+         * after the decimal point */
+        if ((count != 0) || (digit != '0') || (i >= (PRINT_MAX_DIGITS - 1 - decimals)))
+        {
+            digits[count++] = digit;
+        }
+    }
+
+    length = count + (negative ? 1 : 0) + ((decimals != 0) ? 1 : 0);
+
+    if (!zeroPad && (width > length))
+    {
+        PRINT_Pad(' ', width - length);
+    }
+    if (negative)
+    {
+        PRINT_Emit('-');
+    }
+    if (zeroPad && (width > length))
+    {
+        PRINT_Pad('0', width - length);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if ((decimals != 0) && (i == (count - decimals)))
+        {
+            PRINT_Emit('.');
+        }
+        PRINT_Emit(digits[i]);
+    }
+}
+
+/*********************************************************************
+* Function: static void PRINT_Hex(uint32_t value, uint8_t width,
+*                   bool zeroPad, bool upperCase)
+*
+* Overview: Prints a value in hexadecimal
+*
+* PreCondition: none
+*
+* Input: uint32_t value - value to print
+*        uint8_t width - minimum field width
+*        bool zeroPad - pad with zeros instead of spaces
+*        bool upperCase - use A-F rather than a-f
+*
+* Output: None
+*
+********************************************************************/
+static void PRINT_Hex(uint32_t value, uint8_t width, bool zeroPad, bool upperCase)
+{
+    uint8_t count = 8;
+    uint8_t nibble;
+
+    while ((count > 1) && (((value >> ((count - 1) * 4)) & 0x0F) == 0))
+    {
+        count--;
+    }
+
+    if (width > count)
+    {
+        PRINT_Pad(zeroPad ? '0' : ' ', width - count);
+    }
+
+    while (count--)
+    {
+        nibble = (uint8_t)(value >> (count * 4)) & 0x0F;
+        if (nibble < 10)
+        {
+            PRINT_Emit('0' + nibble);
+        }
+        else
+        {
+            PRINT_Emit((upperCase ? 'A' : 'a') + nibble - 10);
+        }
+    }
+}
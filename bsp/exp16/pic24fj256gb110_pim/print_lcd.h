@@ -24,20 +24,25 @@
 #define PRINT_LCD_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <lcd.h>
 
 /* Type Definitions *************************************************/
 typedef enum
 {
-    PRINT_CONFIGURATION_LCD
+    PRINT_CONFIGURATION_LCD,
+    PRINT_CONFIGURATION_UART,
+    PRINT_CONFIGURATION_BUFFER
 } PRINT_CONFIGURATION;
 
 /*********************************************************************
 * Function: bool PRINT_SetConfiguration(PRINT_CONFIGURATION led);
 *
-* Overview: Configures the print configuration
+* Overview: Configures the print configuration.  All following output
+*           goes to the selected sink.  The LCD is initialized the first
+*           time it is selected (several hundred milliseconds).
 *
-* PreCondition: none
+* PreCondition: UART sink: UART_Initialize().  Buffer sink: PRINT_BufferSet().
 *
 * Input: configuration - the print configuration to use.  Some boards
 *         may have more than one print configuration enabled
@@ -47,24 +52,68 @@ typedef enum
 *
 ********************************************************************/
 bool PRINT_SetConfiguration(PRINT_CONFIGURATION configuration);
-#define PRINT_SetConfiguration(configuration) LCD_Initialize()
 
 /*********************************************************************
-* Function: void PRINT_String(char* string, uint16_t length)
+* Function: PRINT_CONFIGURATION PRINT_GetConfiguration(void)
+*
+* Overview: Returns the sink currently selected, so a caller can divert
+*           output briefly and then restore it
+*
+* PreCondition: none
+*
+* Input: None
+*
+* Output: the current print configuration
+*
+********************************************************************/
+PRINT_CONFIGURATION PRINT_GetConfiguration(void);
+
+/*********************************************************************
+* Function: void PRINT_BufferSet(char* buffer, uint16_t size)
+*
+* Overview: Sets the RAM buffer used by PRINT_CONFIGURATION_BUFFER and
+*           empties it.  Output is truncated at size - 1 characters and
+*           the buffer is always null terminated.
+*
+* PreCondition: none
+*
+* Input: char* buffer - destination buffer
+*        uint16_t size - buffer size in bytes
+*
+* Output: None
+*
+********************************************************************/
+void PRINT_BufferSet(char* buffer, uint16_t size);
+
+/*********************************************************************
+* Function: uint16_t PRINT_BufferLength(void)
+*
+* Overview: Returns the number of characters in the RAM buffer
+*
+* PreCondition: PRINT_BufferSet()
+*
+* Input: None
+*
+* Output: uint16_t - characters written since PRINT_BufferSet()
+*
+********************************************************************/
+uint16_t PRINT_BufferLength(void);
+
+/*********************************************************************
+* Function: void PRINT_String(const char* string, uint16_t length)
 *
 * Overview: Prints a string until a null terminator is reached or the
 *           specified string length is printed.
 *
 * PreCondition: none
 *
-* Input: char* string - the string to print.
+* Input: const char* string - the string to print.
 *        uint16_t length - the length of the string.
 *
 * Output: None
 *
 ********************************************************************/
-void PRINT_String(char* string, uint16_t length);
-#define PRINT_String(string, length) LCD_PutString(string, length)
+void PRINT_String(const char* string, uint16_t length);
 
 /*********************************************************************
 * Function: void PRINT_Char(char charToPrint)
@@ -79,12 +128,33 @@ void PRINT_String(char* string, uint16_t length);
 *
 ********************************************************************/
 void PRINT_Char(char charToPrint);
-#define PRINT_Char(charToPrint) LCD_PutChar(charToPrint)
+
+/*********************************************************************
+* Function: void PRINT_Formatted(const char* format, ...)
+*
+* Overview: Small printf replacement.  Conversions are
+*           %[0][width][.decimals][l]<d|u|x|X|s|c> and %%.
+*           - 0 pads numbers with zeros instead of spaces to width
+*           - .decimals prints an integer as fixed point, e.g. %.3u of
+*             3300 gives 3.300
+*           - l takes a 32-bit (long) argument for d, u, x and X
+*           No floating point, no heap, and no division is used.
+*
+* PreCondition: none
+*
+* Input: const char* format - format string
+*        ... - arguments, int (16-bit) unless the l modifier is used
+*
+* Output: None
+*
+********************************************************************/
+void PRINT_Formatted(const char* format, ...);
 
 /*********************************************************************
 * Function: void PRINT_ClearStreen()
 *
-* Overview: Clears the screen, if possible
+* Overview: Clears the screen, if possible.  Empties the buffer when the
+*           buffer sink is selected; ignored by the UART sink.
 *
 * PreCondition: none
 *
@@ -94,12 +164,11 @@ void PRINT_Char(char charToPrint);
 *
 ********************************************************************/
 void PRINT_ClearScreen(void);
-#define PRINT_ClearScreen() LCD_ClearScreen()
 
 /*********************************************************************
 * Function: void PRINT_CursorEnable(bool enable)
 *
-* Overview: Enables/disables the cursor
+* Overview: Enables/disables the cursor (LCD sink only)
 *
 * PreCondition: None
 *
@@ -109,6 +178,5 @@ void PRINT_ClearScreen(void);
 *
 ********************************************************************/
 void PRINT_CursorEnable(bool);
-#define PRINT_CursorEnable(enabled) LCD_CursorEnable(enabled)
 
 #endif //PRINT_LCD_H
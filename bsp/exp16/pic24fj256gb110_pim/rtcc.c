@@ -3,15 +3,69 @@
 #include "rtcc.h"
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 
+#define BSP_RTCC_ALARM_EVERY_SECOND     0x1
+#define BSP_RTCC_ALARM_REPEAT_FOREVER   0xFF
+#define BSP_RTCC_INTERRUPT_PRIORITY     1
+
+// One row of the BCD to decimal table: high nibble tens, low nibbles
+// 0x0 - 0x9 valid, 0xA - 0xF are not BCD and decode to 0xFF
+#define BSP_RTCC_BCD_ROW(tens) \
+    (tens) * 10 + 0, (tens) * 10 + 1, (tens) * 10 + 2, (tens) * 10 + 3, \
+    (tens) * 10 + 4, (tens) * 10 + 5, (tens) * 10 + 6, (tens) * 10 + 7, \
+    (tens) * 10 + 8, (tens) * 10 + 9, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+#define BSP_RTCC_BCD_INVALID_ROW \
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, \
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+
+#define BSP_RTCC_DECIMAL_ROW(tens) \
+    ((tens) << 4) | 0, ((tens) << 4) | 1, ((tens) << 4) | 2, ((tens) << 4) | 3, \
+    ((tens) << 4) | 4, ((tens) << 4) | 5, ((tens) << 4) | 6, ((tens) << 4) | 7, \
+    ((tens) << 4) | 8, ((tens) << 4) | 9
+
+// Decoded copies of the clock, refreshed once a second by the alarm
+// interrupt. The ISR fills the inactive entry and then flips
+// rtccActive, so a reader always copies a complete entry; rtccSequence
+// lets it detect that a refresh happened while it was copying.
+typedef struct
+{
+    BSP_RTCC_DATETIME bcd;
+    BSP_RTCC_DATETIME decimal;
+} BSP_RTCC_SHADOW;
+
+static const uint8_t bcdToDecimal[256] =
+{
+    BSP_RTCC_BCD_ROW (0), BSP_RTCC_BCD_ROW (1), BSP_RTCC_BCD_ROW (2), BSP_RTCC_BCD_ROW (3),
+    BSP_RTCC_BCD_ROW (4), BSP_RTCC_BCD_ROW (5), BSP_RTCC_BCD_ROW (6), BSP_RTCC_BCD_ROW (7),
+    BSP_RTCC_BCD_ROW (8), BSP_RTCC_BCD_ROW (9),
+    BSP_RTCC_BCD_INVALID_ROW, BSP_RTCC_BCD_INVALID_ROW, BSP_RTCC_BCD_INVALID_ROW,
+    BSP_RTCC_BCD_INVALID_ROW, BSP_RTCC_BCD_INVALID_ROW, BSP_RTCC_BCD_INVALID_ROW
+};
+
+static const uint8_t decimalToBcd[100] =
+{
+    BSP_RTCC_DECIMAL_ROW (0), BSP_RTCC_DECIMAL_ROW (1), BSP_RTCC_DECIMAL_ROW (2),
+    BSP_RTCC_DECIMAL_ROW (3), BSP_RTCC_DECIMAL_ROW (4), BSP_RTCC_DECIMAL_ROW (5),
+    BSP_RTCC_DECIMAL_ROW (6), BSP_RTCC_DECIMAL_ROW (7), BSP_RTCC_DECIMAL_ROW (8),
+    BSP_RTCC_DECIMAL_ROW (9)
+};
+
+static BSP_RTCC_SHADOW rtccShadow[2];
+static volatile uint8_t rtccActive = 0;
+static volatile uint16_t rtccSequence = 0;
+static BSP_RTCC_ALARM_HANDLER rtccAlarmHandler = NULL;
+
+static void BSP_RTCC_TimeRead (BSP_RTCC_DATETIME * value);
+static void BSP_RTCC_ShadowRefresh (void);
 uint8_t BSP_RTCC_DecToBCD (uint8_t value);
 uint8_t BSP_RTCC_BCDToDec (uint8_t value);
 
 void BSP_RTCC_Initialize (BSP_RTCC_DATETIME * value)
 {
-   // Turn on the secondary oscillator
-   __builtin_write_OSCCONL(0x02);
+   // Turn on the secondary oscillator, leaving the other OSCCON bits alone
+   __builtin_write_OSCCONL(OSCCON | 0x02);
 
    // Set the RTCWREN bit
    __builtin_write_RTCWEN();
@@ -20,7 +74,11 @@ void BSP_RTCC_Initialize (BSP_RTCC_DATETIME * value)
    RCFGCALbits.RTCPTR1 = 1;
 
    // Set it to the correct time
-   if (value->bcdFormat)
+   if (value == NULL)
+   {
+       // Keep the time the RTCC is already counting
+   }
+   else if (value->bcdFormat)
    {
        RTCVAL = 0x0000 | value->year;
        RTCVAL = ((uint16_t)(value->month) << 8) | value->day;
@@ -41,9 +99,76 @@ void BSP_RTCC_Initialize (BSP_RTCC_DATETIME * value)
 
    // Enable RTCC, clear RTCWREN
    RCFGCAL = 0x8000;
+
+   // Prime the cache before the first alarm
+   IEC3bits.RTCIE = 0;
+   BSP_RTCC_ShadowRefresh ();
+
+   // Alarm on every second rollover, repeating indefinitely
+   ALCFGRPT = 0;
+   ALCFGRPTbits.AMASK = BSP_RTCC_ALARM_EVERY_SECOND;
+   ALCFGRPTbits.ARPT = BSP_RTCC_ALARM_REPEAT_FOREVER;
+   ALCFGRPTbits.CHIME = 1;
+   ALCFGRPTbits.ALRMEN = 1;
+
+   IPC15bits.RTCIP = BSP_RTCC_INTERRUPT_PRIORITY;
+   IFS3bits.RTCIF = 0;
+   IEC3bits.RTCIE = 1;
+}
+
+void BSP_RTCC_AlarmHandlerSet (BSP_RTCC_ALARM_HANDLER handler)
+{
+    bool interruptEnabled = IEC3bits.RTCIE;
+
+    IEC3bits.RTCIE = 0;
+    rtccAlarmHandler = handler;
+    IEC3bits.RTCIE = interruptEnabled;
 }
 
 void BSP_RTCC_TimeGet (BSP_RTCC_DATETIME * value)
+{
+    uint16_t sequence;
+    bool bcdFormat = value->bcdFormat;
+
+    do
+    {
+        sequence = rtccSequence;
+
+        if (bcdFormat)
+        {
+            *value = rtccShadow[rtccActive].bcd;
+        }
+        else
+        {
+            *value = rtccShadow[rtccActive].decimal;
+        }
+    } while (sequence != rtccSequence);
+}
+
+static void BSP_RTCC_ShadowRefresh (void)
+{
+    BSP_RTCC_SHADOW * shadow = &rtccShadow[rtccActive ^ 1];
+
+    BSP_RTCC_TimeRead (&shadow->bcd);
+    shadow->bcd.bcdFormat = true;
+
+    shadow->decimal.bcdFormat = false;
+    shadow->decimal.year = bcdToDecimal[shadow->bcd.year];
+    shadow->decimal.month = bcdToDecimal[shadow->bcd.month];
+    shadow->decimal.day = bcdToDecimal[shadow->bcd.day];
+    shadow->decimal.weekday = bcdToDecimal[shadow->bcd.weekday];
+    shadow->decimal.hour = bcdToDecimal[shadow->bcd.hour];
+    shadow->decimal.minute = bcdToDecimal[shadow->bcd.minute];
+    shadow->decimal.second = bcdToDecimal[shadow->bcd.second];
+
+    rtccActive ^= 1;
+    rtccSequence++;
+}
+
+// Reads the raw BCD registers. The alarm fires just after the second
+// rolls over, so RTCSYNC is normally clear and the retry loop only runs
+// when priming the cache at an unlucky moment.
+static void BSP_RTCC_TimeRead (BSP_RTCC_DATETIME * value)
 {
     uint16_t registerValue;
     bool checkValue;
@@ -89,27 +214,33 @@ void BSP_RTCC_TimeGet (BSP_RTCC_DATETIME * value)
 
         } while (memcmp (value, &tempValue, sizeof (BSP_RTCC_DATETIME)));
     }
+}
 
-    if (!value->bcdFormat)
+// Values above 99 have no two digit BCD form and are clamped to 0x99
+uint8_t BSP_RTCC_DecToBCD (uint8_t value)
+{
+    if (value > 99)
     {
-        value->year = BSP_RTCC_BCDToDec (value->year);
-        value->month = BSP_RTCC_BCDToDec (value->month);
-        value->day = BSP_RTCC_BCDToDec (value->day);
-        value->weekday = BSP_RTCC_BCDToDec (value->weekday);
-        value->hour = BSP_RTCC_BCDToDec (value->hour);
-        value->minute = BSP_RTCC_BCDToDec (value->minute);
-        value->second = BSP_RTCC_BCDToDec (value->second);
+        value = 99;
     }
+
+    return decimalToBcd[value];
 }
 
-// Note : value must be < 100
-uint8_t BSP_RTCC_DecToBCD (uint8_t value)
+uint8_t BSP_RTCC_BCDToDec (uint8_t value)
 {
-    return (((value / 10)) << 4) | (value % 10);
+    return bcdToDecimal[value];
 }
 
-uint8_t BSP_RTCC_BCDToDec (uint8_t value)
+void __attribute__ ( ( __interrupt__ , auto_psv ) ) _RTCCInterrupt ( void )
 {
-    return ((value >> 4) * 10) + (value & 0x0F);
+    BSP_RTCC_ShadowRefresh ();
+
+    if (rtccAlarmHandler != NULL)
+    {
+        rtccAlarmHandler ();
+    }
+
+    IFS3bits.RTCIF = 0;
 }
 
@@ -1,4 +1,7 @@
 
+#ifndef BSP_RTCC_H
+#define BSP_RTCC_H
+
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -14,13 +17,16 @@ typedef struct
     uint8_t second;
 } BSP_RTCC_DATETIME;
 
-void BSP_RTCC_Initialize (BSP_RTCC_DATETIME * value);
-void BSP_RTCC_TimeGet (BSP_RTCC_DATETIME * value);
-
-
-
-
+typedef void (*BSP_RTCC_ALARM_HANDLER)(void);
 
+// Sets the clock (NULL keeps the running time) and starts the 1 Hz alarm
+// that refreshes the cached time
+void BSP_RTCC_Initialize (BSP_RTCC_DATETIME * value);
 
+// Called from the RTCC interrupt once a second, after the cache refresh
+void BSP_RTCC_AlarmHandlerSet (BSP_RTCC_ALARM_HANDLER handler);
 
+// Copies the cached time in the format selected by value->bcdFormat
+void BSP_RTCC_TimeGet (BSP_RTCC_DATETIME * value);
 
+#endif // BSP_RTCC_H
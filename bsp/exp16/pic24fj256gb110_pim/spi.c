@@ -8,23 +8,119 @@
 #include <xc.h>
 #include <spi.h>
 #include <string.h>
-
-#define SS_TRIS     TRISAbits.TRISA0
-#define SS_LAT      LATAbits.LATA0
+#include <system.h>
+#include <trace.h>
 
 #define INPUT  1
 #define OUTPUT 0
 
-bool word_tx_complete = false;
+/* Below the bit bang UART on Timer 3 so SPI traffic does not jitter it */
+#define SPI_INTERRUPT_PRIORITY      3
+
+/* Enhanced buffer mode FIFO depth. Never more words than this are sent
+ * ahead of the ones read back, so the receive FIFO can not overflow */
+#define SPI_FIFO_DEPTH              8
+
+#define SPI_SISEL_RX_NOT_EMPTY      1 // SPIxIF while SRXMPT is clear
+#define SPI_SISEL_TX_SPACE          4 // SPIxIF each time a word moves from the TX FIFO to SPIxSR
+#define SPI_TX_FILL                 0xFFFF // clocked out when tx is NULL
+
+/* SPI1CON1 bits */
+#define SPI_CON1_MODE16             0x0400
+#define SPI_CON1_CKE                0x0100 // output changes on the active to idle clock edge
+#define SPI_CON1_CKP                0x0040 // clock idles high
+#define SPI_CON1_MSTEN              0x0020
+#define SPI_CON1_SPRE_SHIFT         2
+#define SPI_CON1_PPRE_SHIFT         0
+
+/* TRISx sits two registers below LATx on every port */
+#define SPI_TRIS_FROM_LAT(lat)      ((lat) - 2)
+
+/* Stream buffer, a power of two words */
+#define SPI_STREAM_BUFFER_SIZE      64
+#define SPI_STREAM_BUFFER_MASK      (SPI_STREAM_BUFFER_SIZE - 1)
+
+#define SPI_DEMO_CLOCK              7812 // FCY / 512, the slowest setting
+#define SPI_DEMO_MODE               2
+
+/* Demo slave select on RG9 (pin 14), a pin nothing else uses. RA0 is the
+ * bit bang UART line, and SCK1/SDO1 are shared with the 25LC256, which
+ * ignores them while its own chip select (RD12) is high. */
+#define SPI_DEMO_CS_LAT             &LATG
+#define SPI_DEMO_CS_MASK            0x0200
+
 char *messages[7];
 int messageIndex = 0;
 
+static SPI_TRANSACTION * volatile spiHead;
+static SPI_TRANSACTION * volatile spiTail;
+/* Position of the active transaction. Sending runs up to
+ * SPI_FIFO_DEPTH words ahead of receiving, possibly a segment or more */
+static uint8_t spiTxSegment;
+static uint16_t spiTxIndex;
+static uint8_t spiRxSegment;
+static uint16_t spiRxIndex;
+static uint8_t spiInFlight; // words sent and not yet received
+static uint16_t spiCon1; // device setting currently on the bus
+
+/* Framed streaming. SPI_StreamWrite() moves spiStreamHead, the SPI1
+ * interrupt moves spiStreamTail */
+static volatile bool spiStreaming;
+static uint16_t spiStreamBuffer[SPI_STREAM_BUFFER_SIZE];
+static volatile uint16_t spiStreamHead;
+static volatile uint16_t spiStreamTail;
+static uint16_t spiStreamLast; // repeated on underrun
+static volatile uint16_t spiStreamUnderruns;
+
+static SPI_DEVICE spiDemoDevice =
+{
+    SPI_DEMO_CS_LAT, SPI_DEMO_CS_MASK, SPI_DEMO_CLOCK, SPI_DEMO_MODE, 8, 0
+};
+static SPI_SEGMENT spiDemoSegment;
+static SPI_TRANSACTION spiDemoTransaction;
+static SPI_SEGMENT spiTransferSegment;
+static SPI_TRANSACTION spiTransferTransaction;
+
+static uint32_t SPI_Con1Compute(uint32_t clock, uint8_t mode, uint8_t wordBits, uint16_t *con1);
+static void SPI_Start(SPI_TRANSACTION *transaction);
+static void SPI_StreamFill(void);
+static void SPI_TxFill(const SPI_TRANSACTION *transaction);
+static void SPI_RxDrain(const SPI_TRANSACTION *transaction);
+static bool SPI_SegmentFind(const SPI_TRANSACTION *transaction, uint8_t *segment, uint16_t *index);
+static void SPI_ChipSelect(const SPI_DEVICE *device, bool active);
+static void SPI_DemoDone(SPI_TRANSACTION *transaction);
+
+/*********************************************************************
+* Function: SPI_PinsInitialize(void);
+*
+* Overview: Maps the SPI1 pins
+*
+* PreCondition: PPS registers unlocked
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+void SPI_PinsInitialize(void)
+{
+    TRISGbits.TRISG6 = OUTPUT; // RG6 as output (SCK1OUT) pin 10
+    TRISGbits.TRISG7 = INPUT; // RG7 as input (SDI1) pin 11
+    TRISGbits.TRISG8 = OUTPUT; // RG8 as output (SDO1) pin 12
+    TRISBbits.TRISB14 = OUTPUT; // RB14 as output (SS1OUT) pin 43
+    
+    RPOR10bits.RP21R = 8; // RP21 -> SCK1OUT (RG6) pin 10
+    RPINR20bits.SDI1R = 26; // RP26 (RG7) pin 11 -> SDI1
+    RPOR9bits.RP19R = 7; // RP19 -> SDO1 (RG8) pin 12
+    RPOR7bits.RP14R = 9; // RP14 -> SS1OUT (RB14) pin 43, frame sync
+}
+
 /*********************************************************************
 * Function: SPI_Initialize(void);
 *
 * Overview: Initializes SPI
 *
-* PreCondition: none
+* PreCondition: SPI_PinsInitialize()
 *
 * Input: none
 *
@@ -41,48 +137,408 @@ void SPI_Initialize(void)
     messages[5] = "the";
     messages[6] = "message";
     
-    TRISFbits.TRISF8 = OUTPUT; // RF8 as output (SDO1) pin 53
-    TRISBbits.TRISB1 = OUTPUT; // RB1 as output (SCK1OUT) pin 24
-    SS_TRIS = OUTPUT; // RA0 as output (SS)
-    SS_LAT = 1; // set SS idle high
-    
-    // Unlock Registers
-    __builtin_write_OSCCONL(OSCCON & 0xBF);
-    
-    RPOR7bits.RP15R = 7; // RP15 -> SDO1 (RF8) pin 53
-    RPOR0bits.RP1R = 8; // RP1 -> SCK1OUT (RB1) pin 24
-    
-    // Lock Registers
-    __builtin_write_OSCCONL(OSCCON | 0x40);
+    spiHead = NULL;
+    spiTail = NULL;
+    spiStreaming = false;
+    spiStreamHead = 0;
+    spiStreamTail = 0;
     
+    IEC0bits.SPI1IE = 0;
     IFS0bits.SPI1IF = 0; // Clear the SPIxIF bit in the respective IFS register
-    IEC0bits.SPI1IE = 1; // Set the SPIxIE bit in the respective IEC register
-    IPC2bits.SPI1IP = 0x7; // Write the SPIxIP bits in the respective IPC register to set the interrupt priority
+    IPC2bits.SPI1IP = SPI_INTERRUPT_PRIORITY; // Write the SPIxIP bits in the respective IPC register to set the interrupt priority
     
     SPI1STATbits.SPIEN = 0; // SPIxCON1 and SPIxCON2 can not be written while the SPIx modules are enabled. 
                         // The SPIEN (SPIxSTAT<15>) bit must be clear before modifying either register.
-    SPI1STATbits.SISEL = 5; // Interrupt when the last bit is shifted out of SPIxSR, now the transmit is complete
-    
-    SPI1CON1bits.DISSCK = 0; // Internal SPIx clock is enabled
-    SPI1CON1bits.DISSDO = 0; // SDOx pin is controlled by the module
-    SPI1CON1bits.MODE16 = 0; // Communication is byte-wide (8 bits)
-    SPI1CON1bits.SMP = 0; // Input data sampled at middle of data output time
-    SPI1CON1bits.CKE = 1; // Serial output data changes on transition from Idle clock state to active clock state
-    SPI1CON1bits.SSEN = 0; // SSx pin not used for Master
-    SPI1CON1bits.CKP = 1; // Idle state for clock is a low level; active state is a high level
-    SPI1CON1bits.MSTEN = 1; // Master mode
-    SPI1CON1bits.SPRE = 0x0; // Secondary prescale 8:1
-    SPI1CON1bits.PPRE = 0x0; // Primary prescale 64:1git
+    
+    /* Each device brings its own SPI1CON1 (clock, mode, word size). 
+     * Until the first transaction: byte-wide master at the slowest clock,
+     * SCK and SDO driven by the module, SSx pin not used */
+    spiCon1 = SPI_CON1_MSTEN;
+    SPI1CON1 = spiCon1;
     
     SPI1CON2bits.FRMEN = 0; // Framed SPIx support disabled
     SPI1CON2bits.SPIFSD = 0; // Frame sync pulse output (master)
     SPI1CON2bits.SPIFPOL = 0; // Frame sync pulse is active-low
     SPI1CON2bits.SPIFE = 0; // Frame sync pulse precedes first bit clock
-    SPI1CON2bits.SPIBEN = 0; // Enhanced Buffer disabled (Legacy mode)
+    SPI1CON2bits.SPIBEN = 1; // Enhanced Buffer enabled, 8 word FIFOs each way
     
+    SPI1STATbits.SISEL = SPI_SISEL_RX_NOT_EMPTY; // Interrupt while received words are waiting
     SPI1STATbits.SPIROV = 0; // Clear the SPIROV bit (SPIxSTAT<6>)
     
     SPI1STATbits.SPIEN = 1; // Enable SPI operation by setting the SPIEN bit (SPIxSTAT<15>)
+    
+    IEC0bits.SPI1IE = 1; // Set the SPIxIE bit in the respective IEC register
+    
+    SPI_DeviceInitialize(&spiDemoDevice); // SS on RG9, idle high
+}
+
+/*********************************************************************
+* Function: SPI_DeviceInitialize(SPI_DEVICE *device);
+*
+* Overview: Works out the SPI1CON1 setting for a slave and releases its
+*           chip select
+*
+* PreCondition: SPI_Initialize()
+*
+* Input: SPI_DEVICE *device - slave to set up
+*
+* Output: uint32_t - SCK rate that will be used, 0 if invalid
+*
+********************************************************************/
+uint32_t SPI_DeviceInitialize(SPI_DEVICE *device)
+{
+    uint32_t rate;
+    uint16_t con1;
+    uint16_t ipl;
+
+    rate = SPI_Con1Compute(device->clock, device->mode, device->wordBits, &con1);
+    if(rate == 0)
+    {
+        return 0;
+    }
+
+    device->con1 = con1;
+
+    SPI_ChipSelect(device, false);
+
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    *SPI_TRIS_FROM_LAT(device->csLat) &= ~device->csMask;
+    RESTORE_CPU_IPL(ipl);
+
+    return rate;
+}
+
+/*********************************************************************
+* Function: SPI_Con1Compute(uint32_t clock, uint8_t mode, uint8_t wordBits, uint16_t *con1);
+*
+* Overview: Master mode SPI1CON1 value with the prescalers giving the
+*           fastest SCK not above clock
+*
+* PreCondition: none
+*
+* Input: uint32_t clock - fastest SCK wanted, Hz
+*        uint8_t mode - SPI mode 0 to 3
+*        uint8_t wordBits - 8 or 16
+*        uint16_t *con1 - result
+*
+* Output: uint32_t - SCK rate of the result, 0 if invalid
+*
+********************************************************************/
+static uint32_t SPI_Con1Compute(uint32_t clock, uint8_t mode, uint8_t wordBits, uint16_t *con1)
+{
+    static const uint8_t primary[4] = { 64, 16, 4, 1 }; // PPRE = 00 to 11
+    uint32_t rate;
+    uint32_t best = 0;
+    uint8_t ppre;
+    uint8_t secondary;
+    uint8_t bestPpre = 0;
+    uint8_t bestSecondary = 8;
+
+    if((mode > 3) || ((wordBits != 8) && (wordBits != 16)))
+    {
+        return 0;
+    }
+
+    for(ppre = 0; ppre < 4; ppre++)
+    {
+        for(secondary = 1; secondary <= 8; secondary++)
+        {
+            // 1:1 primary with 1:1 secondary is not allowed
+            if((primary[ppre] == 1) && (secondary == 1))
+            {
+                continue;
+            }
+
+            rate = SYSTEM_PERIPHERAL_CLOCK / ((uint16_t)primary[ppre] * secondary);
+            if((rate <= clock) && (rate > best))
+            {
+                best = rate;
+                bestPpre = ppre;
+                bestSecondary = secondary;
+            }
+        }
+    }
+
+    if(best == 0)
+    {
+        return 0;
+    }
+
+    *con1 = SPI_CON1_MSTEN |
+            ((uint16_t)(8 - bestSecondary) << SPI_CON1_SPRE_SHIFT) | // SPRE = 111 is 1:1
+            ((uint16_t)bestPpre << SPI_CON1_PPRE_SHIFT);
+
+    // Microchip CKE is the inverse of CPHA
+    if((mode & 0x01) == 0)
+    {
+        *con1 |= SPI_CON1_CKE;
+    }
+    if(mode & 0x02)
+    {
+        *con1 |= SPI_CON1_CKP;
+    }
+    if(wordBits == 16)
+    {
+        *con1 |= SPI_CON1_MODE16;
+    }
+
+    return best;
+}
+
+/*********************************************************************
+* Function: SPI_TransactionQueue(SPI_TRANSACTION *transaction);
+*
+* Overview: Appends a transaction to the queue, starting it straight
+*           away if the bus is free
+*
+* PreCondition: SPI_DeviceInitialize() for transaction->device
+*
+* Input: SPI_TRANSACTION *transaction - transaction to run
+*
+* Output: true if queued, false if it has no words or is already
+*         queued
+*
+********************************************************************/
+bool SPI_TransactionQueue(SPI_TRANSACTION *transaction)
+{
+    uint16_t ipl;
+    uint8_t segment = 0;
+    uint16_t index = 0;
+
+    if((transaction->device->con1 == 0) ||
+       (SPI_SegmentFind(transaction, &segment, &index) == false))
+    {
+        return false;
+    }
+
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+
+    if(spiStreaming ||
+       (transaction->status == SPI_TRANSACTION_QUEUED) ||
+       (transaction->status == SPI_TRANSACTION_ACTIVE))
+    {
+        RESTORE_CPU_IPL(ipl);
+        return false;
+    }
+
+    transaction->next = NULL;
+    transaction->status = SPI_TRANSACTION_QUEUED;
+
+    if(spiHead == NULL)
+    {
+        spiHead = transaction;
+        spiTail = transaction;
+        SPI_Start(transaction);
+    }
+    else
+    {
+        spiTail->next = transaction;
+        spiTail = transaction;
+    }
+
+    RESTORE_CPU_IPL(ipl);
+    return true;
+}
+
+/*********************************************************************
+* Function: SPI_Transfer(SPI_DEVICE *device, const void *tx, void *rx, uint16_t length);
+*
+* Overview: Full duplex transfer, returns once the last word is in
+*
+* PreCondition: SPI_DeviceInitialize() for device, CPU priority below
+*               SPI_INTERRUPT_PRIORITY
+*
+* Input: SPI_DEVICE *device - slave
+*        const void *tx - words to send, NULL for all ones
+*        void *rx - buffer for the received words, NULL to discard
+*        uint16_t length - number of words
+*
+* Output: true when the transfer completed, false if not queued
+*
+********************************************************************/
+bool SPI_Transfer(SPI_DEVICE *device, const void *tx, void *rx, uint16_t length)
+{
+    SPI_TRANSACTION *transaction = &spiTransferTransaction;
+
+    /* Only the SPI1 interrupt completes the transfer, so waiting for it
+     * at or above its priority would never return */
+    if(SRbits.IPL >= SPI_INTERRUPT_PRIORITY)
+    {
+        return false;
+    }
+
+    spiTransferSegment.tx = tx;
+    spiTransferSegment.rx = rx;
+    spiTransferSegment.length = length;
+
+    transaction->device = device;
+    transaction->segments = &spiTransferSegment;
+    transaction->segmentCount = 1;
+    transaction->callback = NULL;
+
+    if(SPI_TransactionQueue(transaction) == false)
+    {
+        return false;
+    }
+
+    while(transaction->status != SPI_TRANSACTION_DONE)
+    {
+    }
+
+    return true;
+}
+
+/*********************************************************************
+* Function: SPI_IsBusy(void);
+*
+* Overview: Reports whether transactions are queued or running
+*
+* PreCondition: SPI_Initialize()
+*
+* Input: none
+*
+* Output: true while the queue is not empty
+*
+********************************************************************/
+bool SPI_IsBusy(void)
+{
+    return (spiHead != NULL);
+}
+
+/*********************************************************************
+* Function: SPI_StreamStart(const SPI_STREAM_CONFIGURATION *config);
+*
+* Overview: Switches SPI1 to framed 16 bit streaming
+*
+* PreCondition: SPI_Initialize(), no transactions queued
+*
+* Input: const SPI_STREAM_CONFIGURATION *config - clock and frame sync
+*
+* Output: uint32_t - SCK rate that will be used, 0 if not started
+*
+********************************************************************/
+uint32_t SPI_StreamStart(const SPI_STREAM_CONFIGURATION *config)
+{
+    uint32_t rate;
+    uint16_t con1;
+    uint16_t ipl;
+
+    rate = SPI_Con1Compute(config->clock, config->mode, 16, &con1);
+    if(rate == 0)
+    {
+        return 0;
+    }
+
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+
+    if(spiStreaming || (spiHead != NULL))
+    {
+        RESTORE_CPU_IPL(ipl);
+        return 0;
+    }
+
+    spiStreaming = true;
+    spiStreamLast = 0;
+    spiStreamUnderruns = 0;
+
+    SPI1STATbits.SPIEN = 0; // SPIxCON1 and SPIxCON2 can only be written while disabled
+    SPI1CON1 = con1;
+    spiCon1 = con1;
+    SPI1CON2bits.SPIFPOL = config->syncActiveHigh;
+    SPI1CON2bits.SPIFE = config->syncWithFirstBit;
+    SPI1CON2bits.FRMEN = 1; // Framed SPIx, sync pulse driven by SPI1 (SPIFSD = 0)
+    SPI1STATbits.SISEL = SPI_SISEL_TX_SPACE;
+    SPI1STATbits.SPIROV = 0;
+    SPI1STATbits.SPIEN = 1;
+
+    SPI_StreamFill(); // the first words start the interrupts
+
+    RESTORE_CPU_IPL(ipl);
+
+    return rate;
+}
+
+/*********************************************************************
+* Function: SPI_StreamStop(void);
+*
+* Overview: Stops streaming and returns SPI1 to transactions
+*
+* PreCondition: none
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+void SPI_StreamStop(void)
+{
+    uint16_t ipl;
+
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+
+    if(spiStreaming)
+    {
+        SPI1STATbits.SPIEN = 0; // also empties both FIFOs
+        SPI1CON2bits.FRMEN = 0;
+        SPI1STATbits.SISEL = SPI_SISEL_RX_NOT_EMPTY;
+        SPI1STATbits.SPIROV = 0;
+        SPI1STATbits.SPIEN = 1;
+        IFS0bits.SPI1IF = 0;
+
+        spiStreaming = false;
+    }
+
+    spiStreamHead = 0;
+    spiStreamTail = 0;
+
+    RESTORE_CPU_IPL(ipl);
+}
+
+/*********************************************************************
+* Function: SPI_StreamWrite(const uint16_t *words, uint16_t count);
+*
+* Overview: Copies words into the stream buffer
+*
+* PreCondition: none
+*
+* Input: const uint16_t *words - words to stream
+*        uint16_t count - number of words
+*
+* Output: uint16_t - number of words taken
+*
+********************************************************************/
+uint16_t SPI_StreamWrite(const uint16_t *words, uint16_t count)
+{
+    uint16_t head = spiStreamHead;
+    uint16_t written = 0;
+
+    while((written < count) &&
+          (((head + 1) & SPI_STREAM_BUFFER_MASK) != spiStreamTail))
+    {
+        spiStreamBuffer[head] = words[written++];
+        head = (head + 1) & SPI_STREAM_BUFFER_MASK;
+    }
+
+    spiStreamHead = head; // publish after the words are in place
+
+    return written;
+}
+
+/*********************************************************************
+* Function: SPI_StreamUnderrunsGet(void);
+*
+* Overview: Number of words repeated because the stream buffer was empty
+*
+* PreCondition: none
+*
+* Input: none
+*
+* Output: uint16_t - underrun count since SPI_StreamStart()
+*
+********************************************************************/
+uint16_t SPI_StreamUnderrunsGet(void)
+{
+    return spiStreamUnderruns;
 }
 
 /*********************************************************************
@@ -94,44 +550,333 @@ void SPI_Initialize(void)
 *
 * Input: none
 *
-* Output: none
+* Output: true if queued
 *
 ********************************************************************/
-void SPI_Transmit(void)
+bool SPI_Transmit(void)
 {
-    int i = 0;
-    int strLength = strlen(messages[messageIndex]);
-    char *ptr = messages[messageIndex];
+    if(spiDemoTransaction.status == SPI_TRANSACTION_QUEUED ||
+       spiDemoTransaction.status == SPI_TRANSACTION_ACTIVE)
+    {
+        return false; // the last message is still going out
+    }
+    
+    spiDemoSegment.tx = messages[messageIndex];
+    spiDemoSegment.rx = NULL;
+    spiDemoSegment.length = strlen(messages[messageIndex]);
     
-    // drop SS (active)
-    SS_LAT = 0;
+    spiDemoTransaction.device = &spiDemoDevice;
+    spiDemoTransaction.segments = &spiDemoSegment;
+    spiDemoTransaction.segmentCount = 1;
+    spiDemoTransaction.callback = SPI_DemoDone;
     
-    for (; i < strLength; i++)
+    return SPI_TransactionQueue(&spiDemoTransaction);
+}
+
+/*********************************************************************
+* Function: SPI_Start(SPI_TRANSACTION *transaction);
+*
+* Overview: Puts the transaction's device settings on the bus, asserts
+*           its chip select and fills the transmit FIFO
+*
+* PreCondition: Bus idle, called with interrupts held off or from the
+*               SPI1 interrupt
+*
+* Input: SPI_TRANSACTION *transaction - head of the queue
+*
+* Output: none
+*
+********************************************************************/
+static void SPI_Start(SPI_TRANSACTION *transaction)
+{
+    const SPI_DEVICE *device = transaction->device;
+
+    if(device->con1 != spiCon1)
     {
-        SPI1BUF = *ptr++;
-        
-        while(SPI1STATbits.SPITBF) {} // wait for SPIx Transmit Buffer Full Status bit to enter 
-                                      // 'Transmit started, SPIxTXB is empty' state
+        // SPIxCON1 can not be written while the module is enabled
+        SPI1STATbits.SPIEN = 0;
+        SPI1CON1 = device->con1;
+        SPI1STATbits.SPIEN = 1;
+        spiCon1 = device->con1;
     }
+
+    transaction->status = SPI_TRANSACTION_ACTIVE;
+    spiTxSegment = 0;
+    spiTxIndex = 0;
+    spiRxSegment = 0;
+    spiRxIndex = 0;
+    spiInFlight = 0;
+
+    SPI_ChipSelect(device, true);
+    SPI_TxFill(transaction);
+}
+
+/*********************************************************************
+* Function: SPI_StreamFill(void);
+*
+* Overview: Tops the transmit FIFO up from the stream buffer, repeating
+*           the last word when the buffer is empty so the frames keep
+*           their timing. Received words are thrown away.
+*
+* PreCondition: Streaming
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+static void SPI_StreamFill(void)
+{
+    uint16_t tail = spiStreamTail;
+
+    while(SPI1STATbits.SRXMPT == 0)
+    {
+        (void)SPI1BUF;
+    }
+
+    while(SPI1STATbits.SPITBF == 0)
+    {
+        if(tail != spiStreamHead)
+        {
+            spiStreamLast = spiStreamBuffer[tail];
+            tail = (tail + 1) & SPI_STREAM_BUFFER_MASK;
+        }
+        else
+        {
+            spiStreamUnderruns++;
+        }
+
+        SPI1BUF = spiStreamLast;
+    }
+
+    spiStreamTail = tail;
+}
+
+/*********************************************************************
+* Function: SPI_TxFill(const SPI_TRANSACTION *transaction);
+*
+* Overview: Writes words of the active transaction to SPI1BUF, moving
+*           from segment to segment, until SPI_FIFO_DEPTH words are in
+*           flight or all are sent
+*
+* PreCondition: Transaction active
+*
+* Input: const SPI_TRANSACTION *transaction - active transaction
+*
+* Output: none
+*
+********************************************************************/
+static void SPI_TxFill(const SPI_TRANSACTION *transaction)
+{
+    const SPI_SEGMENT *segment;
+    uint16_t word;
+
+    while((spiInFlight < SPI_FIFO_DEPTH) &&
+          (SPI1STATbits.SPITBF == 0) &&
+          SPI_SegmentFind(transaction, &spiTxSegment, &spiTxIndex))
+    {
+        segment = &transaction->segments[spiTxSegment];
+
+        if(segment->tx == NULL)
+        {
+            word = SPI_TX_FILL;
+        }
+        else if(transaction->device->wordBits == 16)
+        {
+            word = ((const uint16_t *)segment->tx)[spiTxIndex];
+        }
+        else
+        {
+            word = ((const uint8_t *)segment->tx)[spiTxIndex];
+        }
+
+        SPI1BUF = word;
+        spiTxIndex++;
+        spiInFlight++;
+    }
+}
+
+/*********************************************************************
+* Function: SPI_RxDrain(const SPI_TRANSACTION *transaction);
+*
+* Overview: Reads every waiting word out of the receive FIFO into the
+*           rx buffers of the active transaction's segments
+*
+* PreCondition: Transaction active
+*
+* Input: const SPI_TRANSACTION *transaction - active transaction
+*
+* Output: none
+*
+********************************************************************/
+static void SPI_RxDrain(const SPI_TRANSACTION *transaction)
+{
+    const SPI_SEGMENT *segment;
+    uint16_t word;
+
+    while(SPI1STATbits.SRXMPT == 0)
+    {
+        word = SPI1BUF;
+
+        if(SPI_SegmentFind(transaction, &spiRxSegment, &spiRxIndex) == false)
+        {
+            continue; // never expected, keeps the FIFO empty regardless
+        }
+
+        segment = &transaction->segments[spiRxSegment];
+
+        if(segment->rx != NULL)
+        {
+            if(transaction->device->wordBits == 16)
+            {
+                ((uint16_t *)segment->rx)[spiRxIndex] = word;
+            }
+            else
+            {
+                ((uint8_t *)segment->rx)[spiRxIndex] = (uint8_t)word;
+            }
+        }
+
+        spiRxIndex++;
+        spiInFlight--;
+    }
+}
+
+/*********************************************************************
+* Function: SPI_SegmentFind(const SPI_TRANSACTION *transaction, uint8_t *segment, uint16_t *index);
+*
+* Overview: Steps a segment and word position past the ends of
+*           finished and empty segments
+*
+* PreCondition: none
+*
+* Input: const SPI_TRANSACTION *transaction - transaction to walk
+*        uint8_t *segment - segment number, updated
+*        uint16_t *index - word within the segment, updated
+*
+* Output: true if the position is on a word, false at the end of the
+*         transaction
+*
+********************************************************************/
+static bool SPI_SegmentFind(const SPI_TRANSACTION *transaction, uint8_t *segment, uint16_t *index)
+{
+    while(*segment < transaction->segmentCount)
+    {
+        if(*index < transaction->segments[*segment].length)
+        {
+            return true;
+        }
+
+        (*segment)++;
+        *index = 0;
+    }
+
+    return false;
+}
+
+/*********************************************************************
+* Function: SPI_ChipSelect(const SPI_DEVICE *device, bool active);
+*
+* Overview: Drives a chip select. The LATx read-modify-write is done
+*           with interrupts held off because other pins of the port are
+*           written from interrupts (LEDs, bit bang UART).
+*
+* PreCondition: none
+*
+* Input: const SPI_DEVICE *device - slave
+*        bool active - true to select (drive low)
+*
+* Output: none
+*
+********************************************************************/
+static void SPI_ChipSelect(const SPI_DEVICE *device, bool active)
+{
+    uint16_t ipl;
+
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    if(active)
+    {
+        *device->csLat &= ~device->csMask;
+    }
+    else
+    {
+        *device->csLat |= device->csMask;
+    }
+    RESTORE_CPU_IPL(ipl);
+}
+
+/*********************************************************************
+* Function: SPI_DemoDone(SPI_TRANSACTION *transaction);
+*
+* Overview: Moves the demo on to the next message
+*
+* PreCondition: Called from the SPI1 interrupt
+*
+* Input: SPI_TRANSACTION *transaction - finished demo transaction
+*
+* Output: none
+*
+********************************************************************/
+static void SPI_DemoDone(SPI_TRANSACTION *transaction)
+{
+    TRACE_Event(TRACE_EVENT_SPI_WORD_DONE, messageIndex);
+    messageIndex++;
     
-    word_tx_complete = true;
+    if(messageIndex > 6)
+        messageIndex = 0;
 }
 
 /*
- SPI1 transfer completed interrupt
+ SPI1 receive interrupt, raised while the receive FIFO holds words.
+ Every received word is read, and the transmit side never runs more
+ than the FIFO depth ahead, so SPIROV can not set.
  */
 void __attribute__ ( ( __interrupt__ , auto_psv ) ) _SPI1Interrupt(void)
 {    
-    if(word_tx_complete)
+    SPI_TRANSACTION *transaction = spiHead;
+    
+    IFS0bits.SPI1IF = 0; // Clear the SPIxIF bit in the respective IFS register   
+    
+    if(spiStreaming)
     {
-        SS_LAT = 1;
-        word_tx_complete = false;
-        messageIndex++;
-        
-        if(messageIndex > 6)
-            messageIndex = 0;
+        SPI_StreamFill();
+        return;
+    }
+    
+    if(transaction == NULL)
+    {
+        while(SPI1STATbits.SRXMPT == 0)
+        {
+            (void)SPI1BUF;
+        }
+        return;
+    }
+    
+    SPI_RxDrain(transaction);
+    
+    if(SPI_SegmentFind(transaction, &spiRxSegment, &spiRxIndex))
+    {
+        SPI_TxFill(transaction);
+        return;
+    }
+    
+    // Last word received, release the slave and move on
+    SPI_ChipSelect(transaction->device, false);
+    
+    spiHead = transaction->next;
+    if(spiHead == NULL)
+    {
+        spiTail = NULL;
+    }
+    else
+    {
+        SPI_Start(spiHead);
+    }
+    
+    // after the next start, so a callback that queues again is not started twice
+    transaction->status = SPI_TRANSACTION_DONE;
+    if(transaction->callback != NULL)
+    {
+        transaction->callback(transaction);
     }
-
-    IFS0bits.SPI1IF = 0; // Clear the SPIxIF bit in the respective IFS register   
-    SPI1STATbits.SPIROV = 0; // Clear the SPIROV bit (SPIxSTAT<6>) - not doing this seems to cause an issue after two writes to the register
 }
\ No newline at end of file
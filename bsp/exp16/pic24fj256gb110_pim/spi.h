@@ -33,13 +33,92 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+
+/* One slave on SPI1. Fill in the public fields and call
+ * SPI_DeviceInitialize() before queueing transactions for it. */
+typedef struct
+{
+    volatile uint16_t *csLat;   // LATx register of the active low chip select
+    uint16_t csMask;            // chip select bit in csLat
+    uint32_t clock;             // fastest SCK the slave accepts, Hz
+    uint8_t mode;               // SPI mode 0 to 3 (CPOL << 1 | CPHA)
+    uint8_t wordBits;           // 8 or 16
+    uint16_t con1;              // SPI1CON1 value, set by SPI_DeviceInitialize()
+} SPI_DEVICE;
+
+typedef enum
+{
+    SPI_TRANSACTION_IDLE = 0,   // never queued
+    SPI_TRANSACTION_QUEUED,
+    SPI_TRANSACTION_ACTIVE,     // chip select asserted, words moving
+    SPI_TRANSACTION_DONE
+} SPI_TRANSACTION_STATUS;
+
+/* One piece of a transaction. Consecutive segments are sent as one
+ * unbroken transfer, so a header, a payload held elsewhere and a CRC
+ * go out without being copied together first. */
+typedef struct
+{
+    const void *tx;             // words to send, uint8_t or uint16_t per wordBits, NULL sends all ones
+    void *rx;                   // received words, same size as tx, NULL to discard
+    uint16_t length;            // number of words, may be 0
+} SPI_SEGMENT;
+
+typedef struct SPI_TRANSACTION SPI_TRANSACTION;
+
+/* Called from the SPI1 interrupt when a transaction has finished and its
+ * chip select is released. May queue further transactions. */
+typedef void (*SPI_CALLBACK)(SPI_TRANSACTION *transaction);
+
+/* One chip select framed transfer made of one or more segments. The
+ * caller owns the transaction, segments and buffers, which must stay
+ * valid until the status is SPI_TRANSACTION_DONE. */
+struct SPI_TRANSACTION
+{
+    SPI_DEVICE *device;
+    const SPI_SEGMENT *segments;
+    uint8_t segmentCount;
+    SPI_CALLBACK callback;      // NULL for none
+    volatile SPI_TRANSACTION_STATUS status;
+    SPI_TRANSACTION *next;      // queue link, private
+};
+
+/* Framed streaming of 16 bit words, for DACs, codecs and DSPs. SPI1
+ * drives a frame sync pulse on SS1OUT (RB14) for every word. */
+typedef struct
+{
+    uint32_t clock;             // fastest SCK wanted, Hz
+    uint8_t mode;               // SPI mode 0 to 3 (CPOL << 1 | CPHA)
+    bool syncActiveHigh;        // frame sync polarity (SPIFPOL)
+    bool syncWithFirstBit;      // sync coincides with, rather than precedes, the first bit clock (SPIFE)
+} SPI_STREAM_CONFIGURATION;
+
+/*********************************************************************
+* Function: SPI_PinsInitialize(void);
+*
+* Overview: Routes SPI1 through the peripheral pin select to the
+*           25LC256 EEPROM pins: SCK1 on RG6, SDI1 on RG7, SDO1 on RG8.
+*           SS1OUT (framed streaming) goes to RB14.
+*
+* PreCondition: PPS registers unlocked. The mapping locks for good at
+*               the first relock (IOL1WAY), so this is called from the
+*               one unlock window in SYS_Initialize().
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+void SPI_PinsInitialize(void);
 
 /*********************************************************************
 * Function: SPI_Initialize(void);
 *
-* Overview: Initializes SPI
+* Overview: Initializes SPI1 as an interrupt driven master with an
+*           empty transaction queue
 *
-* PreCondition: none
+* PreCondition: SPI_PinsInitialize()
 *
 * Input: none
 *
@@ -49,9 +128,108 @@
 void SPI_Initialize(void);
 
 /*********************************************************************
-* Function: SPI_Transmit(void);
+* Function: SPI_DeviceInitialize(SPI_DEVICE *device);
+*
+* Overview: Works out the SPI1CON1 setting for a slave: the prescalers
+*           giving the fastest clock not above device->clock, the clock
+*           polarity and phase for device->mode and the word size. The
+*           chip select is driven high (inactive) and made an output.
+*
+* PreCondition: SPI_Initialize()
 *
-* Overview: Transmits the next SPI message in the internal buffer
+* Input: SPI_DEVICE *device - slave to set up
+*
+* Output: uint32_t - SCK rate that will be used, 0 if the settings are
+*         invalid or the clock is below FCY / 512
+*
+********************************************************************/
+uint32_t SPI_DeviceInitialize(SPI_DEVICE *device);
+
+/*********************************************************************
+* Function: SPI_TransactionQueue(SPI_TRANSACTION *transaction);
+*
+* Overview: Appends a transaction to the queue. Transactions run back
+*           to back from the SPI1 interrupt in the order queued: the bus
+*           is reconfigured when the device settings differ, the chip
+*           select is asserted, the words of every segment are sent in
+*           turn and the chip select is released before the callback is
+*           made. Does not block and is safe to call from interrupts and
+*           callbacks.
+*
+* PreCondition: SPI_DeviceInitialize() for transaction->device
+*
+* Input: SPI_TRANSACTION *transaction - transaction to run
+*
+* Output: true if queued, false if it has no words or is already
+*         queued
+*
+********************************************************************/
+bool SPI_TransactionQueue(SPI_TRANSACTION *transaction);
+
+/*********************************************************************
+* Function: SPI_Transfer(SPI_DEVICE *device, const void *tx, void *rx, uint16_t length);
+*
+* Overview: Full duplex transfer of length words to and from a slave,
+*           queued behind any transactions already waiting. Returns
+*           once the last word has been received. tx NULL clocks out
+*           all ones (reads), rx NULL discards the received words.
+*           Uses the SPI1 interrupt, so must not be called from an
+*           interrupt or callback; refused at CPU priority 3 (the SPI1
+*           interrupt priority) or above.
+*
+* PreCondition: SPI_DeviceInitialize() for device
+*
+* Input: SPI_DEVICE *device - slave
+*        const void *tx - words to send
+*        void *rx - buffer for the received words
+*        uint16_t length - number of words
+*
+* Output: true when the transfer completed, false if it could not be
+*         queued or the CPU priority is too high
+*
+********************************************************************/
+bool SPI_Transfer(SPI_DEVICE *device, const void *tx, void *rx, uint16_t length);
+
+/*********************************************************************
+* Function: SPI_IsBusy(void);
+*
+* Overview: Reports whether transactions are queued or running
+*
+* PreCondition: SPI_Initialize()
+*
+* Input: none
+*
+* Output: true while the queue is not empty
+*
+********************************************************************/
+bool SPI_IsBusy(void);
+
+/*********************************************************************
+* Function: SPI_StreamStart(const SPI_STREAM_CONFIGURATION *config);
+*
+* Overview: Switches SPI1 to framed 16 bit streaming. Words written
+*           with SPI_StreamWrite() are fed to the transmit FIFO from
+*           the SPI1 interrupt so they go out without gaps. When the
+*           stream buffer runs dry the last word is repeated and an
+*           underrun is counted. Transactions are refused until
+*           SPI_StreamStop().
+*
+* PreCondition: SPI_Initialize(), no transactions queued. Write the
+*               first words before starting to avoid early underruns.
+*
+* Input: const SPI_STREAM_CONFIGURATION *config - clock and frame sync
+*
+* Output: uint32_t - SCK rate that will be used, 0 if the stream could
+*         not be started
+*
+********************************************************************/
+uint32_t SPI_StreamStart(const SPI_STREAM_CONFIGURATION *config);
+
+/*********************************************************************
+* Function: SPI_StreamStop(void);
+*
+* Overview: Stops streaming, discards unsent words and returns SPI1 to
+*           transactions
 *
 * PreCondition: none
 *
@@ -60,7 +238,55 @@ void SPI_Initialize(void);
 * Output: none
 *
 ********************************************************************/
-void SPI_Transmit(void);
+void SPI_StreamStop(void);
+
+/*********************************************************************
+* Function: SPI_StreamWrite(const uint16_t *words, uint16_t count);
+*
+* Overview: Copies words into the stream buffer. Does not block.
+*
+* PreCondition: none
+*
+* Input: const uint16_t *words - words to stream
+*        uint16_t count - number of words
+*
+* Output: uint16_t - number of words taken, less than count when the
+*         stream buffer is full
+*
+********************************************************************/
+uint16_t SPI_StreamWrite(const uint16_t *words, uint16_t count);
+
+/*********************************************************************
+* Function: SPI_StreamUnderrunsGet(void);
+*
+* Overview: Number of words repeated because the stream buffer was
+*           empty when the transmit FIFO needed filling
+*
+* PreCondition: none
+*
+* Input: none
+*
+* Output: uint16_t - underrun count since SPI_StreamStart()
+*
+********************************************************************/
+uint16_t SPI_StreamUnderrunsGet(void);
+
+/*********************************************************************
+* Function: SPI_Transmit(void);
+*
+* Overview: Queues the next demo message for the slave on RG9. Skipped
+*           while the previous message is still being sent. Run by the
+*           "spi" console command.
+*
+* PreCondition: SPI_Initialize()
+*
+* Input: none
+*
+* Output: true if queued, false if the previous message is still being
+*         sent or SPI1 is streaming
+*
+********************************************************************/
+bool SPI_Transmit(void);
 
 #endif	/* SPI_H */
 
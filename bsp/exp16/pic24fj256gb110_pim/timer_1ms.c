@@ -25,6 +25,8 @@
 #include <xc.h>
 #include <string.h>
 #include <timer_1ms.h>
+#include <system.h>
+#include <trace.h>
 
 /* Definitions *****************************************************/
 #define STOP_TIMER_IN_IDLE_MODE     0x2000
@@ -41,9 +43,23 @@
 #define TIMER_INTERRUPT_PRIORITY    0x0001
 #define TIMER_INTERRUPT_PRIORITY_4  0x0004
 
+#define TIMER_TICK_PERIOD           ((SYSTEM_CYCLES_PER_MICRO_SECOND * TIMER_TICK_INTERVAL_MICRO_SECONDS) - 1)
+
+// Hashed timing wheel used by the tick service. An entry due in n ticks is
+// hashed into slot (cursor + n) % TIMER_WHEEL_SLOTS and carries the number
+// of whole wheel revolutions it must wait, so inserting and expiring an
+// entry never walks more than one slot.
+#define TIMER_MAX_TICK_HANDLERS     8
+#define TIMER_WHEEL_SLOTS           16  // must be a power of two
+#define TIMER_WHEEL_SHIFT           4   // log2(TIMER_WHEEL_SLOTS)
+#define TIMER_WHEEL_MASK            (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_END             0xFF
+
 #define UART_SIM_TRIS   TRISAbits.TRISA0 // RA0 direction state (input / output)
 #define UART_SIM_LAT    LATAbits.LATA0 // RA0 output state (high / low)
 
+#define UART_SIM_DEFAULT_BAUD       9600
+
 /** Type definitions *********************************/
 typedef enum
 {
@@ -54,6 +70,23 @@ typedef enum
     STOP
 } TRANSMIT_STATE;
 
+typedef enum
+{
+    TICK_FREE = 0,
+    TICK_ARMED,     // linked into a wheel slot
+    TICK_DUE        // expired, linked into the due list awaiting its call
+} TICK_STATE;
+
+typedef struct
+{
+    TICK_HANDLER handle;
+    uint32_t rate;      // reload in ticks, 0 for a one-shot
+    uint32_t rounds;    // wheel revolutions left before expiry
+    uint8_t next;       // next entry in the same slot or due list
+    uint8_t slot;
+    TICK_STATE state;
+} TICK_ENTRY;
+
 // global variables
 bool service_uart_emulation = false;
 unsigned int data_bits_tx_mode = 0;
@@ -61,21 +94,39 @@ unsigned int data_bits_tx_mode = 0;
 // local variables
 char *message_start;
 char *message;
-char *message32 = "32b "; // 4 bytes (32 bits) long
-char *message24 = "24b"; // 3 bytes (24 bits) long
-char *message16 = "16"; // 2 bytes (16 bits) long
+const char *message32 = "32b "; // 4 bytes (32 bits) long
+const char *message24 = "24b"; // 3 bytes (24 bits) long
+const char *message16 = "16"; // 2 bytes (16 bits) long
 int output_bit = 0;
 int length;
 int stopBitsCount;
 int numberOfStopBits;
 int numberOfDataBits;
-int issue_parity_bit = 4;// None - 0, Odd - 1, Even - 2, Mark - 3, Space - 4 (default to space)
+int issue_parity_bit = UART_PARITY_SPACE; // UART_PARITY (default to space)
+bool parity_accumulator = false; // xor of the data bits sent so far
 TRANSMIT_STATE transmit_state = IDLE;
 
+static char uartSimPayload[UART_SIM_MAX_PAYLOAD_BYTES];
+static uint32_t uartSimBaud = UART_SIM_DEFAULT_BAUD;
+static volatile uint16_t uartSimFramesSent;
+static bool uartSimAddressMode;
+static uint8_t uartSimCharacter; // payload byte being sent in address mode
+
+static TICK_ENTRY tickEntries[TIMER_MAX_TICK_HANDLERS];
+static uint8_t tickWheel[TIMER_WHEEL_SLOTS];
+static uint8_t tickDueHead = TIMER_WHEEL_END;
+static uint8_t tickCursor = 0;
+
+static bool TIMER_TickAdd(TICK_HANDLER handle, uint32_t rate, uint32_t delay);
+static void TIMER_TickInsert(uint8_t index, uint32_t delay);
+static void TIMER_TickUnlink(uint8_t index);
+static bool UART_SIM_Lock(void);
+
 /*********************************************************************
  * Function: void TIMER_SetConfiguration(void)
  *
- * Overview: Initializes the timer.
+ * Overview: Initializes the timers. Timer 3 drives the bit bang UART
+ *           and Timer 2 drives the 1ms tick service.
  *
  * PreCondition: None
  *
@@ -86,21 +137,20 @@ TRANSMIT_STATE transmit_state = IDLE;
  ********************************************************************/
 void TIMER_SetConfiguration(void)
 {
-    message = message32;
-    message_start = message;    
-    length = strlen(message);
+    UART_SIM_SetPayload(message32);
     stopBitsCount = 0;
     numberOfStopBits = 1;
     
     UART_SIM_TRIS = 0; // RA0 as output (pin 58)
     UART_SIM_LAT = 1; // RA0 set high (pin 58)
     
-    IPC2bits.T3IP = TIMER_INTERRUPT_PRIORITY;
+    // the bit bang UART must not be delayed by tick handlers on Timer 2
+    IPC2bits.T3IP = TIMER_INTERRUPT_PRIORITY_4;
     IFS0bits.T3IF = 0;
 
     TMR3 = 0;
 
-    PR3 = 416; // 9600 baud (7us - 16.38ms range)
+    PR3 = (SYSTEM_PERIPHERAL_CLOCK + (uartSimBaud / 2)) / uartSimBaud - 1; // 416 at 9600 baud (7us - 16.38ms range)
 
     T3CON = TIMER_ON |
             STOP_TIMER_IN_IDLE_MODE |
@@ -110,8 +160,237 @@ void TIMER_SetConfiguration(void)
             TIMER_PRESCALER_1;
 
     IEC0bits.T3IE = 1;
+
+    memset(tickEntries, 0, sizeof(tickEntries));
+    memset(tickWheel, TIMER_WHEEL_END, sizeof(tickWheel));
+    tickDueHead = TIMER_WHEEL_END;
+    tickCursor = 0;
+
+    IPC1bits.T2IP = TIMER_INTERRUPT_PRIORITY;
+    IFS0bits.T2IF = 0;
+
+    TMR2 = 0;
+
+    PR2 = TIMER_TICK_PERIOD; // 1ms tick
+
+    T2CON = TIMER_ON |
+            STOP_TIMER_IN_IDLE_MODE |
+            TIMER_SOURCE_INTERNAL |
+            GATED_TIME_DISABLED |
+            TIMER_16BIT_MODE |
+            TIMER_PRESCALER_1;
+
+    IEC0bits.T2IE = 1;
 }
 
+/*********************************************************************
+* Function: bool TIMER_RequestTick(TICK_HANDLER handle, uint32_t rate)
+*
+* Overview: Requests to receive a periodic event. The handle is called
+*           from the Timer 2 interrupt every rate ticks until it is
+*           cancelled. Requesting a handle that is already registered
+*           updates its rate.
+*
+* PreCondition: TIMER_SetConfiguration() has been called
+*
+* Input:  handle - the function that will be called when the event
+*           is triggered
+*         rate - the number of ticks between calls to the handle
+*
+* Output: true if successful, false if rate is zero or no handler slot
+*         is free
+*
+********************************************************************/
+bool TIMER_RequestTick(TICK_HANDLER handle, uint32_t rate)
+{
+    return TIMER_TickAdd(handle, rate, rate);
+}
+
+/*********************************************************************
+* Function: bool TIMER_RequestOneShot(TICK_HANDLER handle, uint32_t delay)
+*
+* Overview: Requests a single event. The handle is called once from the
+*           Timer 2 interrupt after delay ticks and is then released.
+*
+* PreCondition: TIMER_SetConfiguration() has been called
+*
+* Input:  handle - the function that will be called when the event
+*           is triggered
+*         delay - the number of ticks before the handle is called
+*
+* Output: true if successful, false if delay is zero or no handler slot
+*         is free
+*
+********************************************************************/
+bool TIMER_RequestOneShot(TICK_HANDLER handle, uint32_t delay)
+{
+    return TIMER_TickAdd(handle, 0, delay);
+}
+
+/*********************************************************************
+* Function: void TIMER_CancelTick(TICK_HANDLER handle)
+*
+* Overview: Cancels a periodic or one-shot event request.
+*
+* PreCondition: None
+*
+* Input:  handle - the function that was registered
+*
+* Output: None
+*
+********************************************************************/
+void TIMER_CancelTick(TICK_HANDLER handle)
+{
+    uint8_t i;
+    bool interruptEnabled = IEC0bits.T2IE;
+
+    IEC0bits.T2IE = 0;
+
+    for (i = 0; i < TIMER_MAX_TICK_HANDLERS; i++)
+    {
+        if ((tickEntries[i].state != TICK_FREE) && (tickEntries[i].handle == handle))
+        {
+            TIMER_TickUnlink(i);
+            tickEntries[i].state = TICK_FREE;
+            break;
+        }
+    }
+
+    IEC0bits.T2IE = interruptEnabled;
+}
+
+/*********************************************************************
+* Function: static bool TIMER_TickAdd(TICK_HANDLER handle, uint32_t rate,
+*                                     uint32_t delay)
+*
+* Overview: Registers (or re-registers) a handle so that it first fires
+*           after delay ticks and then every rate ticks. May be called
+*           from main or from a tick handler, but not from other
+*           interrupts.
+*
+* Input:  handle - the function to call
+*         rate - reload in ticks, 0 for a one-shot
+*         delay - ticks until the first call
+*
+* Output: true if successful, false otherwise
+*
+********************************************************************/
+static bool TIMER_TickAdd(TICK_HANDLER handle, uint32_t rate, uint32_t delay)
+{
+    uint8_t i;
+    uint8_t index = TIMER_WHEEL_END;
+    bool interruptEnabled;
+
+    if ((handle == NULL) || (delay == 0))
+    {
+        return false;
+    }
+
+    interruptEnabled = IEC0bits.T2IE;
+    IEC0bits.T2IE = 0;
+
+    for (i = 0; i < TIMER_MAX_TICK_HANDLERS; i++)
+    {
+        if (tickEntries[i].state == TICK_FREE)
+        {
+            if (index == TIMER_WHEEL_END)
+            {
+                index = i;
+            }
+        }
+        else if (tickEntries[i].handle == handle)
+        {
+            TIMER_TickUnlink(i);
+            index = i;
+            break;
+        }
+    }
+
+    if (index != TIMER_WHEEL_END)
+    {
+        tickEntries[index].handle = handle;
+        tickEntries[index].rate = rate;
+        TIMER_TickInsert(index, delay);
+    }
+
+    IEC0bits.T2IE = interruptEnabled;
+
+    return (index != TIMER_WHEEL_END);
+}
+
+/*********************************************************************
+* Function: static void TIMER_TickInsert(uint8_t index, uint32_t delay)
+*
+* Overview: Links an entry into the wheel slot that is visited delay
+*           ticks from now.
+*
+* PreCondition: Timer 2 interrupt disabled or called from its ISR
+*
+* Input:  index - entry to insert
+*         delay - ticks until the entry expires, must be non-zero
+*
+* Output: None
+*
+********************************************************************/
+static void TIMER_TickInsert(uint8_t index, uint32_t delay)
+{
+    TICK_ENTRY *entry = &tickEntries[index];
+    uint8_t slot = (uint8_t)((tickCursor + delay) & TIMER_WHEEL_MASK);
+
+    entry->rounds = (delay - 1) >> TIMER_WHEEL_SHIFT;
+    entry->slot = slot;
+    entry->state = TICK_ARMED;
+    entry->next = tickWheel[slot];
+    tickWheel[slot] = index;
+}
+
+/*********************************************************************
+* Function: static void TIMER_TickUnlink(uint8_t index)
+*
+* Overview: Removes an entry from the wheel slot or due list it is on.
+*
+* PreCondition: Timer 2 interrupt disabled or called from its ISR
+*
+* Input:  index - entry to remove
+*
+* Output: None
+*
+********************************************************************/
+static void TIMER_TickUnlink(uint8_t index)
+{
+    uint8_t *link;
+
+    if (tickEntries[index].state == TICK_ARMED)
+    {
+        link = &tickWheel[tickEntries[index].slot];
+    }
+    else
+    {
+        link = &tickDueHead;
+    }
+
+    while (*link != TIMER_WHEEL_END)
+    {
+        if (*link == index)
+        {
+            *link = tickEntries[index].next;
+            return;
+        }
+        link = &tickEntries[*link].next;
+    }
+}
+
+/*********************************************************************
+* Function: void ToggleDataBits(void)
+*
+* Overview: Toggle the data bits transmission mode. Between 32, 24 and
+* 16 data bits transmission
+*
+* Input:  None
+*
+* Output: None
+*
+********************************************************************/
 void ToggleDataBits(void)
 {
     int remainder = ++data_bits_tx_mode % 3; // toggle data bits mode on explorer 16 S3 button press
@@ -120,30 +399,27 @@ void ToggleDataBits(void)
     {
         case 0:
         {
-            message = message32;
+            UART_SIM_SetPayload(message32);
             break;
         }
         case 1:
         {
-            message = message24;
+            UART_SIM_SetPayload(message24);
             break;
         }
         case 2:
         {
-            message = message16;
+            UART_SIM_SetPayload(message16);
             break;
         }
     }
-    
-    message_start = message;
-    length = strlen(message);
 }
 
 /*********************************************************************
 * Function: void ToggleStopBits(void)
 *
 * Overview: Toggle the stop bits transmission mode. Between 0, 1, 2 
-* bits.
+* bits, skipping 0 in address mode.
 *
 * Input:  None
 *
@@ -152,8 +428,14 @@ void ToggleDataBits(void)
 ********************************************************************/
 void ToggleStopBits(void)
 {
-    if(++numberOfStopBits % 3 == 0) // toggle stop bits on explorer 16 S5 button press
-        numberOfStopBits = 0;
+    uint8_t stopBits = (numberOfStopBits + 1) % 3; // toggle stop bits on explorer 16 S5 button press
+
+    if ((stopBits == 0) && uartSimAddressMode)
+    {
+        stopBits = 1;
+    }
+
+    UART_SIM_SetStopBits(stopBits);
 }
 
 /*********************************************************************
@@ -169,8 +451,291 @@ void ToggleStopBits(void)
 ********************************************************************/
 void ToggleParityBit(void)
 {
-    if(++issue_parity_bit % 5 == 0) // toggle parity bit mode on explorer 16 S4 button press
-        issue_parity_bit = 0;
+    UART_SIM_SetParity((issue_parity_bit + 1) % 5); // toggle parity bit mode on explorer 16 S4 button press
+}
+
+/*********************************************************************
+* Function: bool UART_SIM_SetDataBits(uint8_t dataBits)
+*
+* Overview: Sets the number of data bits per frame. The payload is
+*           padded with spaces if it is shorter than the new length.
+*
+* PreCondition: None
+*
+* Input:  dataBits - 8 to UART_SIM_MAX_PAYLOAD_BYTES * 8, multiple of 8
+*
+* Output: true if applied, false if out of range or a frame is in
+*         progress
+*
+********************************************************************/
+bool UART_SIM_SetDataBits(uint8_t dataBits)
+{
+    bool interruptEnabled = IEC0bits.T3IE;
+
+    if ((dataBits == 0) || (dataBits & 0x07) || (dataBits > (UART_SIM_MAX_PAYLOAD_BYTES * 8)))
+    {
+        return false;
+    }
+
+    if (!UART_SIM_Lock())
+    {
+        return false;
+    }
+
+    length = dataBits >> 3;
+    message_start = uartSimPayload;
+    message = message_start;
+
+    IEC0bits.T3IE = interruptEnabled;
+    return true;
+}
+
+/*********************************************************************
+* Function: bool UART_SIM_SetPayload(const char *payload)
+*
+* Overview: Sets the bytes sent in each frame. The data bits follow the
+*           payload length.
+*
+* PreCondition: None
+*
+* Input:  payload - 1 to UART_SIM_MAX_PAYLOAD_BYTES characters
+*
+* Output: true if applied, false if the length is out of range or a
+*         frame is in progress
+*
+********************************************************************/
+bool UART_SIM_SetPayload(const char *payload)
+{
+    bool interruptEnabled = IEC0bits.T3IE;
+    size_t payloadLength = strlen(payload);
+
+    if ((payloadLength == 0) || (payloadLength > UART_SIM_MAX_PAYLOAD_BYTES))
+    {
+        return false;
+    }
+
+    if (!UART_SIM_Lock())
+    {
+        return false;
+    }
+
+    memset(uartSimPayload, ' ', sizeof(uartSimPayload));
+    memcpy(uartSimPayload, payload, payloadLength);
+    length = payloadLength;
+    message_start = uartSimPayload;
+    message = message_start;
+
+    IEC0bits.T3IE = interruptEnabled;
+    return true;
+}
+
+/*********************************************************************
+* Function: bool UART_SIM_SetParity(UART_PARITY parity)
+*
+* Overview: Sets the parity bit sent after the data bits. Odd and even
+*           parity are computed over all data bits of the frame.
+*
+* PreCondition: None
+*
+* Input:  parity - parity setting
+*
+* Output: true if applied, false if invalid or a frame is in progress
+*
+********************************************************************/
+bool UART_SIM_SetParity(UART_PARITY parity)
+{
+    bool interruptEnabled = IEC0bits.T3IE;
+
+    if (parity > UART_PARITY_SPACE)
+    {
+        return false;
+    }
+
+    if (!UART_SIM_Lock())
+    {
+        return false;
+    }
+
+    issue_parity_bit = parity;
+
+    IEC0bits.T3IE = interruptEnabled;
+    return true;
+}
+
+/*********************************************************************
+* Function: bool UART_SIM_SetStopBits(uint8_t stopBits)
+*
+* Overview: Sets the number of stop bits
+*
+* PreCondition: None
+*
+* Input:  stopBits - 0, 1 or 2, at least 1 in address mode
+*
+* Output: true if applied, false if invalid or a frame is in progress
+*
+********************************************************************/
+bool UART_SIM_SetStopBits(uint8_t stopBits)
+{
+    bool interruptEnabled = IEC0bits.T3IE;
+
+    // Without a stop bit the 9th bit runs straight into the next start bit
+    if ((stopBits > 2) || ((stopBits == 0) && uartSimAddressMode))
+    {
+        return false;
+    }
+
+    if (!UART_SIM_Lock())
+    {
+        return false;
+    }
+
+    numberOfStopBits = stopBits;
+
+    IEC0bits.T3IE = interruptEnabled;
+    return true;
+}
+
+/*********************************************************************
+* Function: bool UART_SIM_SetBaud(uint32_t baud)
+*
+* Overview: Sets the bit rate by reloading the Timer 3 period
+*
+* PreCondition: TIMER_SetConfiguration() to take effect on the timer
+*
+* Input:  baud - UART_SIM_MIN_BAUD to UART_SIM_MAX_BAUD
+*
+* Output: true if applied, false if out of range or a frame is in
+*         progress
+*
+********************************************************************/
+bool UART_SIM_SetBaud(uint32_t baud)
+{
+    bool interruptEnabled = IEC0bits.T3IE;
+
+    if ((baud < UART_SIM_MIN_BAUD) || (baud > UART_SIM_MAX_BAUD))
+    {
+        return false;
+    }
+
+    if (!UART_SIM_Lock())
+    {
+        return false;
+    }
+
+    uartSimBaud = baud;
+    PR3 = (SYSTEM_PERIPHERAL_CLOCK + (baud / 2)) / baud - 1;
+    TMR3 = 0;
+
+    IEC0bits.T3IE = interruptEnabled;
+    return true;
+}
+
+/*********************************************************************
+* Function: bool UART_SIM_SetAddressMode(bool enable)
+*
+* Overview: Switches 9-bit multidrop framing on or off
+*
+* PreCondition: None
+*
+* Input:  enable - true for 9-bit address framing
+*
+* Output: true if applied, false if a frame is in progress or no stop
+*         bits are set
+*
+********************************************************************/
+bool UART_SIM_SetAddressMode(bool enable)
+{
+    bool interruptEnabled = IEC0bits.T3IE;
+
+    // Each 9-bit character must be framed by at least one stop bit
+    if (enable && (numberOfStopBits == 0))
+    {
+        return false;
+    }
+
+    if (!UART_SIM_Lock())
+    {
+        return false;
+    }
+
+    uartSimAddressMode = enable;
+
+    IEC0bits.T3IE = interruptEnabled;
+    return true;
+}
+
+/*********************************************************************
+* Function: bool UART_SIM_Send(void)
+*
+* Overview: Requests transmission of one frame
+*
+* PreCondition: TIMER_SetConfiguration()
+*
+* Input:  None
+*
+* Output: true if started, false if a frame is already in progress
+*
+********************************************************************/
+bool UART_SIM_Send(void)
+{
+    if (service_uart_emulation)
+    {
+        return false;
+    }
+
+    service_uart_emulation = true;
+    return true;
+}
+
+/*********************************************************************
+* Function: void UART_SIM_GetConfiguration(UART_SIM_CONFIGURATION *configuration)
+*
+* Overview: Reports the current frame format and the frames sent
+*
+* PreCondition: None
+*
+* Input:  configuration - where to store the settings
+*
+* Output: None
+*
+********************************************************************/
+void UART_SIM_GetConfiguration(UART_SIM_CONFIGURATION *configuration)
+{
+    configuration->dataBits = length * 8;
+    configuration->parity = issue_parity_bit;
+    configuration->stopBits = numberOfStopBits;
+    configuration->baud = uartSimBaud;
+    configuration->framesSent = uartSimFramesSent;
+    configuration->busy = service_uart_emulation;
+    configuration->addressMode = uartSimAddressMode;
+    memcpy(configuration->payload, uartSimPayload, sizeof(configuration->payload));
+}
+
+/*********************************************************************
+* Function: static bool UART_SIM_Lock(void)
+*
+* Overview: Holds off the Timer 3 interrupt so the frame settings can
+*           be changed. Fails, leaving the interrupt as it was, while a
+*           frame is being sent. On success the caller restores T3IE.
+*
+* Input:  None
+*
+* Output: true if the settings may be changed
+*
+********************************************************************/
+static bool UART_SIM_Lock(void)
+{
+    bool interruptEnabled = IEC0bits.T3IE;
+
+    IEC0bits.T3IE = 0;
+
+    if (service_uart_emulation || (transmit_state != IDLE))
+    {
+        IEC0bits.T3IE = interruptEnabled;
+        return false;
+    }
+
+    return true;
 }
 
 /****************************************************************************
@@ -200,13 +765,19 @@ void __attribute__ ( ( __interrupt__ , auto_psv ) ) _T3Interrupt ( void )
         {
             if(service_uart_emulation)
             {
+                uartSimCharacter = 0;
                 transmit_state = START; // initiate send if we receive explorer 16 S6 button press
             }
             break;
         }
         case START:
         {
+            if(uartSimCharacter == 0)
+            {
+                TRACE_Event(TRACE_EVENT_UART_SIM_START, length * 8);
+            }
             UART_SIM_LAT = 0;
+            parity_accumulator = false;
             transmit_state = DATA;            
             break;
         }
@@ -219,11 +790,18 @@ void __attribute__ ( ( __interrupt__ , auto_psv ) ) _T3Interrupt ( void )
             else
                 UART_SIM_LAT = 0;
 
+            parity_accumulator ^= high;
+
             
             if(++output_bit == 8)
             {
                 output_bit = 0; // reset output_bit if required
                 message++; // increment message pointer
+
+                if(uartSimAddressMode)
+                {
+                    transmit_state = PARITY; // one byte per character, the 9th bit follows
+                }
             }
 
             // reset start of message
@@ -236,9 +814,30 @@ void __attribute__ ( ( __interrupt__ , auto_psv ) ) _T3Interrupt ( void )
         }
         case PARITY:
         {
-            if(issue_parity_bit != 0)
+            if(uartSimAddressMode)
+            {
+                UART_SIM_LAT = (uartSimCharacter == 0); // 9th bit marks the address
+                transmit_state = STOP;
+                break;
+            }
+
+            if(issue_parity_bit != UART_PARITY_NONE)
             {
-                UART_SIM_LAT = 0; // currently only support space parity level
+                switch(issue_parity_bit)
+                {
+                    case UART_PARITY_ODD:
+                        UART_SIM_LAT = !parity_accumulator; // odd number of ones including the parity bit
+                        break;
+                    case UART_PARITY_EVEN:
+                        UART_SIM_LAT = parity_accumulator;
+                        break;
+                    case UART_PARITY_MARK:
+                        UART_SIM_LAT = 1;
+                        break;
+                    default:
+                        UART_SIM_LAT = 0;
+                        break;
+                }
                 transmit_state = STOP;
                 break;
             }
@@ -247,12 +846,29 @@ void __attribute__ ( ( __interrupt__ , auto_psv ) ) _T3Interrupt ( void )
         }
         case STOP:
         {
-            UART_SIM_LAT = 1; 
+            if(numberOfStopBits != 0)
+            {
+                UART_SIM_LAT = 1; 
+                ++stopBitsCount;
+            }
             
-            if(++stopBitsCount == numberOfStopBits)
+            if(stopBitsCount >= numberOfStopBits)
             {
                 stopBitsCount = 0; // reset stop bits counter
+
+                if(uartSimAddressMode && (++uartSimCharacter < length))
+                {
+                    transmit_state = START; // next character of the frame
+                    break;
+                }
+
+                // Line idles high. Driven once here rather than on every idle
+                // tick, as RA0 is shared with LED D3; this also ends a frame
+                // sent without stop bits.
+                UART_SIM_LAT = 1;
                 transmit_state = IDLE;
+                uartSimFramesSent++;
+                TRACE_Event(TRACE_EVENT_UART_SIM_END, length * 8);
                 service_uart_emulation = false; // finish transmitting message       
             }            
             break;
@@ -261,4 +877,78 @@ void __attribute__ ( ( __interrupt__ , auto_psv ) ) _T3Interrupt ( void )
 
     // clear timer interrupt
     IFS0bits.T3IF = 0;
-}
\ No newline at end of file
+}
+
+/****************************************************************************
+  Function:
+    void __attribute__((__interrupt__, auto_psv)) _T2Interrupt(void)
+
+  Description:
+    1ms tick ISR. Advances the timing wheel by one slot, moves the entries
+    that expire on this tick to the due list and then calls them. Periodic
+    entries are re-armed before their handler runs so a handler may cancel
+    or re-request itself.
+
+  Precondition:
+    None
+
+  Parameters:
+    None
+
+  Return Values:
+    None
+
+  Remarks:
+    None
+ ***************************************************************************/
+void __attribute__ ( ( __interrupt__ , auto_psv ) ) _T2Interrupt ( void )
+{
+    uint8_t index;
+    uint8_t *link;
+    TICK_ENTRY *entry;
+    TICK_HANDLER handle;
+
+    // clear timer interrupt first so a long handler does not lose a tick
+    IFS0bits.T2IF = 0;
+
+    tickCursor = (tickCursor + 1) & TIMER_WHEEL_MASK;
+
+    link = &tickWheel[tickCursor];
+    while (*link != TIMER_WHEEL_END)
+    {
+        index = *link;
+        entry = &tickEntries[index];
+
+        if (entry->rounds != 0)
+        {
+            entry->rounds--;
+            link = &entry->next;
+        }
+        else
+        {
+            *link = entry->next;
+            entry->next = tickDueHead;
+            entry->state = TICK_DUE;
+            tickDueHead = index;
+        }
+    }
+
+    while (tickDueHead != TIMER_WHEEL_END)
+    {
+        index = tickDueHead;
+        entry = &tickEntries[index];
+        tickDueHead = entry->next;
+        handle = entry->handle;
+
+        if (entry->rate != 0)
+        {
+            TIMER_TickInsert(index, entry->rate);
+        }
+        else
+        {
+            entry->state = TICK_FREE;
+        }
+
+        handle();
+    }
+}
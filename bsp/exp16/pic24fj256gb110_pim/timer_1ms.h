@@ -24,21 +24,41 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <xc.h>
+#include <uart.h>
 
 #ifndef TIMER_1MS
 #define TIMER_1MS
 
 #define TIMER_TICK_INTERVAL_MICRO_SECONDS 1000
 
+/* Bit bang UART limits. The bit rate is bounded by the Timer 3 interrupt
+   cost at 4 MIPS at the top and by the 16-bit period at the bottom. */
+#define UART_SIM_MAX_PAYLOAD_BYTES  8
+#define UART_SIM_MIN_BAUD           300
+#define UART_SIM_MAX_BAUD           19200
+
 extern bool service_uart_emulation;
 
 /* Type Definitions ***********************************************/
 typedef void (*TICK_HANDLER)(void);
 
+typedef struct
+{
+    uint8_t dataBits;
+    UART_PARITY parity;
+    uint8_t stopBits;
+    uint32_t baud;
+    uint16_t framesSent;
+    bool busy;
+    bool addressMode;           // 9-bit characters, see UART_SIM_SetAddressMode()
+    char payload[UART_SIM_MAX_PAYLOAD_BYTES];   // not null terminated
+} UART_SIM_CONFIGURATION;
+
 /*********************************************************************
 * Function: void TIMER_SetConfiguration(void)
 *
-* Overview: Initializes the timer.
+* Overview: Initializes the timers. Timer 3 drives the bit bang UART
+*           and Timer 2 drives the 1ms tick service.
 *
 * Input:  None
 *
@@ -47,11 +67,57 @@ typedef void (*TICK_HANDLER)(void);
 ********************************************************************/
 void TIMER_SetConfiguration(void);
 
+/*********************************************************************
+* Function: bool TIMER_RequestTick(TICK_HANDLER handle, uint32_t rate)
+*
+* Overview: Requests to receive a periodic event. The handle is called
+*           from the Timer 2 interrupt every rate ticks until it is
+*           cancelled. Requesting a handle that is already registered
+*           updates its rate.
+*
+* Input:  handle - the function that will be called when the event
+*           is triggered
+*         rate - the number of ticks between calls to the handle
+*
+* Output: true if successful, false if rate is zero or no handler slot
+*         is free
+*
+********************************************************************/
+bool TIMER_RequestTick(TICK_HANDLER handle, uint32_t rate);
+
+/*********************************************************************
+* Function: bool TIMER_RequestOneShot(TICK_HANDLER handle, uint32_t delay)
+*
+* Overview: Requests a single event. The handle is called once from the
+*           Timer 2 interrupt after delay ticks and is then released.
+*
+* Input:  handle - the function that will be called when the event
+*           is triggered
+*         delay - the number of ticks before the handle is called
+*
+* Output: true if successful, false if delay is zero or no handler slot
+*         is free
+*
+********************************************************************/
+bool TIMER_RequestOneShot(TICK_HANDLER handle, uint32_t delay);
+
+/*********************************************************************
+* Function: void TIMER_CancelTick(TICK_HANDLER handle)
+*
+* Overview: Cancels a periodic or one-shot event request.
+*
+* Input:  handle - the function that was registered
+*
+* Output: None
+*
+********************************************************************/
+void TIMER_CancelTick(TICK_HANDLER handle);
+
 /*********************************************************************
 * Function: void ToggleDataBits(void)
 *
-* Overview: Toggle the data bits transmission mode. Between 32, 24, 
-* 16, 9 data bits transmission
+* Overview: Toggle the data bits transmission mode. Between 32, 24 and
+* 16 data bits transmission
 *
 * Input:  None
 *
@@ -86,4 +152,111 @@ void ToggleStopBits(void);
 ********************************************************************/
 void ToggleParityBit(void);
 
+/*********************************************************************
+* Function: bool UART_SIM_SetDataBits(uint8_t dataBits)
+*
+* Overview: Sets the number of data bits per frame. The payload is
+*           padded with spaces if it is shorter than the new length.
+*
+* Input:  dataBits - 8 to UART_SIM_MAX_PAYLOAD_BYTES * 8, multiple of 8
+*
+* Output: true if applied, false if out of range or a frame is in
+*         progress
+*
+********************************************************************/
+bool UART_SIM_SetDataBits(uint8_t dataBits);
+
+/*********************************************************************
+* Function: bool UART_SIM_SetPayload(const char *payload)
+*
+* Overview: Sets the bytes sent in each frame. The data bits follow the
+*           payload length.
+*
+* Input:  payload - 1 to UART_SIM_MAX_PAYLOAD_BYTES characters
+*
+* Output: true if applied, false if the length is out of range or a
+*         frame is in progress
+*
+********************************************************************/
+bool UART_SIM_SetPayload(const char *payload);
+
+/*********************************************************************
+* Function: bool UART_SIM_SetParity(UART_PARITY parity)
+*
+* Overview: Sets the parity bit sent after the data bits
+*
+* Input:  parity - parity setting
+*
+* Output: true if applied, false if invalid or a frame is in progress
+*
+********************************************************************/
+bool UART_SIM_SetParity(UART_PARITY parity);
+
+/*********************************************************************
+* Function: bool UART_SIM_SetStopBits(uint8_t stopBits)
+*
+* Overview: Sets the number of stop bits
+*
+* Input:  stopBits - 0, 1 or 2, at least 1 in address mode
+*
+* Output: true if applied, false if invalid or a frame is in progress
+*
+********************************************************************/
+bool UART_SIM_SetStopBits(uint8_t stopBits);
+
+/*********************************************************************
+* Function: bool UART_SIM_SetBaud(uint32_t baud)
+*
+* Overview: Sets the bit rate
+*
+* Input:  baud - UART_SIM_MIN_BAUD to UART_SIM_MAX_BAUD
+*
+* Output: true if applied, false if out of range or a frame is in
+*         progress
+*
+********************************************************************/
+bool UART_SIM_SetBaud(uint32_t baud);
+
+/*********************************************************************
+* Function: bool UART_SIM_SetAddressMode(bool enable)
+*
+* Overview: Switches 9-bit multidrop framing on or off. When on, each
+*           payload byte is sent as its own character of 8 data bits
+*           and a 9th bit in place of parity. The 9th bit is set on the
+*           first character, the address, and clear on the data that
+*           follows, so a hardware UART with address detection (ADDEN)
+*           only wakes for frames addressed to it.
+*
+* Input:  enable - true for 9-bit address framing
+*
+* Output: true if applied, false if a frame is in progress or the stop
+*         bits are set to 0
+*
+********************************************************************/
+bool UART_SIM_SetAddressMode(bool enable);
+
+/*********************************************************************
+* Function: bool UART_SIM_Send(void)
+*
+* Overview: Requests transmission of one frame
+*
+* Input:  None
+*
+* Output: true if started, false if a frame is already in progress
+*
+********************************************************************/
+bool UART_SIM_Send(void);
+
+/*********************************************************************
+* Function: void UART_SIM_GetConfiguration(UART_SIM_CONFIGURATION *configuration)
+*
+* Overview: Reports the current frame format and the frames sent
+*
+* Input:  configuration - where to store the settings
+*
+* Output: None
+*
+********************************************************************/
+void UART_SIM_GetConfiguration(UART_SIM_CONFIGURATION *configuration);
+
 #endif //TIMER_1MS
@@ -0,0 +1,104 @@
+
+/*
+ * File:   timestamp.c
+ *
+ * Free running 32-bit timestamp. Timer 4 and Timer 5 are chained in
+ * 32-bit mode and clocked at FCY, so one tick is one instruction cycle.
+ */
+
+#include <xc.h>
+#include <timestamp.h>
+
+#define TIME_TIMER_ON       0x8000
+#define TIME_TIMER_32BIT    0x0008
+
+/*********************************************************************
+* Function: TIME_Initialize(void);
+*
+* Overview: Starts Timer 4/5 as a free running 32-bit counter
+*
+* PreCondition: none
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+void TIME_Initialize(void)
+{
+    T4CON = 0;
+    T5CON = 0;
+
+    IEC1bits.T5IE = 0; // no interrupt, the counter just wraps
+    IFS1bits.T5IF = 0;
+
+    TMR5 = 0;
+    TMR4 = 0;
+    PR5 = 0xFFFF; // 32-bit period PR5:PR4
+    PR4 = 0xFFFF;
+
+    T4CON = TIME_TIMER_ON | TIME_TIMER_32BIT; // internal clock, 1:1 prescaler
+}
+
+/*********************************************************************
+* Function: TIME_NowTicks(void);
+*
+* Overview: Returns the current timestamp
+*
+* PreCondition: TIME_Initialize()
+*
+* Input: none
+*
+* Output: uint32_t - ticks since TIME_Initialize(), modulo 2^32
+*
+********************************************************************/
+uint32_t TIME_NowTicks(void)
+{
+    uint16_t ipl;
+    uint16_t low;
+    uint16_t high;
+
+    /* Reading TMR4 latches TMR5 into TMR5HLD. An interrupt that reads the
+     * timer in between would overwrite TMR5HLD, so the pair is read with
+     * all interrupts held off (a handful of cycles). */
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    low = TMR4;
+    high = TMR5HLD;
+    RESTORE_CPU_IPL(ipl);
+
+    return ((uint32_t)high << 16) | low;
+}
+
+/*********************************************************************
+* Function: TIME_ElapsedTicks(uint32_t start);
+*
+* Overview: Returns the ticks elapsed since start
+*
+* PreCondition: TIME_Initialize()
+*
+* Input: uint32_t start - earlier timestamp
+*
+* Output: uint32_t - elapsed ticks
+*
+********************************************************************/
+uint32_t TIME_ElapsedTicks(uint32_t start)
+{
+    return TIME_NowTicks() - start;
+}
+
+/*********************************************************************
+* Function: TIME_TicksToMicroseconds(uint32_t ticks);
+*
+* Overview: Converts a tick count to microseconds
+*
+* PreCondition: none
+*
+* Input: uint32_t ticks - tick count or interval
+*
+* Output: uint32_t - microseconds
+*
+********************************************************************/
+uint32_t TIME_TicksToMicroseconds(uint32_t ticks)
+{
+    return ticks / TIME_TICKS_PER_MICRO_SECOND; // constant power of two, compiles to a shift
+}
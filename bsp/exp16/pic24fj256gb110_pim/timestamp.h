@@ -0,0 +1,102 @@
+/* Microchip Technology Inc. and its subsidiaries.  You may use this software 
+ * and any derivatives exclusively with Microchip products. 
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES, WHETHER 
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED 
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A 
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION 
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION. 
+ *
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, 
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND 
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS 
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE 
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS 
+ * IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF 
+ * ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE 
+ * TERMS. 
+ */
+
+/* 
+ * File:   timestamp.h
+ * Author: 
+ * Comments: 32-bit free running timestamp on the Timer 4/5 pair
+ * Revision history: 
+ */
+
+// This is a guard condition so that contents of this file are not included
+// more than once.  
+#ifndef TIMESTAMP_H
+#define	TIMESTAMP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <system.h>
+
+/* One tick is one instruction cycle (Timer 4/5 run at FCY, 1:1) */
+#define TIME_TICKS_PER_MICRO_SECOND     SYSTEM_CYCLES_PER_MICRO_SECOND
+
+/*********************************************************************
+* Function: TIME_Initialize(void);
+*
+* Overview: Starts Timer 4/5 as a free running 32-bit counter. The
+*           count wraps after 2^32 ticks (~17.9 minutes at 4 MHz).
+*
+* PreCondition: none
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+void TIME_Initialize(void);
+
+/*********************************************************************
+* Function: TIME_NowTicks(void);
+*
+* Overview: Returns the current timestamp. Safe to call from main and
+*           from interrupts of any priority.
+*
+* PreCondition: TIME_Initialize()
+*
+* Input: none
+*
+* Output: uint32_t - ticks since TIME_Initialize(), modulo 2^32
+*
+********************************************************************/
+uint32_t TIME_NowTicks(void);
+
+/*********************************************************************
+* Function: TIME_ElapsedTicks(uint32_t start);
+*
+* Overview: Returns the ticks elapsed since a timestamp taken with
+*           TIME_NowTicks(). Correct across a counter wrap as long as
+*           the interval is shorter than 2^32 ticks.
+*
+* PreCondition: TIME_Initialize()
+*
+* Input: uint32_t start - earlier timestamp
+*
+* Output: uint32_t - elapsed ticks
+*
+********************************************************************/
+uint32_t TIME_ElapsedTicks(uint32_t start);
+
+/*********************************************************************
+* Function: TIME_TicksToMicroseconds(uint32_t ticks);
+*
+* Overview: Converts a tick count to microseconds
+*
+* PreCondition: none
+*
+* Input: uint32_t ticks - tick count or interval
+*
+* Output: uint32_t - microseconds
+*
+********************************************************************/
+uint32_t TIME_TicksToMicroseconds(uint32_t ticks);
+
+#endif	/* TIMESTAMP_H */
+
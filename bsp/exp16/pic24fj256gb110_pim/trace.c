@@ -0,0 +1,173 @@
+
+/*
+ * File:   trace.c
+ *
+ * In-RAM event trace. Each trace point claims the next slot of a power
+ * of two ring with a single index increment and fills in an 8-byte record,
+ * so it is cheap enough to leave enabled in production builds.
+ */
+
+#include <xc.h>
+#include <trace.h>
+#include <timestamp.h>
+#include <uart.h>
+
+#define TRACE_BUFFER_MASK   (TRACE_BUFFER_SIZE - 1)
+
+#if (TRACE_BUFFER_SIZE & TRACE_BUFFER_MASK) != 0
+#error "TRACE_BUFFER_SIZE must be a power of two"
+#endif
+
+static TRACE_RECORD traceBuffer[TRACE_BUFFER_SIZE];
+static volatile uint16_t traceHead = 0; // records written, free running
+static volatile bool traceEnabled = true;
+
+static uint16_t TRACE_Send(const void *data, uint16_t length, uint16_t checksum);
+
+/*********************************************************************
+* Function: TRACE_Event(uint16_t id, uint16_t arg);
+*
+* Overview: Appends a record to the trace ring
+*
+* PreCondition: TIME_Initialize()
+*
+* Input: uint16_t id - TRACE_EVENT or application event id
+*        uint16_t arg - event specific argument
+*
+* Output: none
+*
+********************************************************************/
+void TRACE_Event(uint16_t id, uint16_t arg)
+{
+    uint16_t ipl;
+    uint16_t index;
+    uint32_t timestamp;
+    TRACE_RECORD *record;
+
+    if (!traceEnabled)
+    {
+        return;
+    }
+
+    // Claim the slot and take the timestamp together so records are in
+    // time order even when a higher priority interrupt traces in between
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    index = traceHead++;
+    timestamp = TIME_NowTicks();
+    RESTORE_CPU_IPL(ipl);
+
+    record = &traceBuffer[index & TRACE_BUFFER_MASK];
+    record->id = id;
+    record->arg = arg;
+    record->timestamp = timestamp;
+}
+
+/*********************************************************************
+* Function: TRACE_Enable(bool enable);
+*
+* Overview: Starts or stops recording
+*
+* PreCondition: none
+*
+* Input: bool enable - true to record events
+*
+* Output: none
+*
+********************************************************************/
+void TRACE_Enable(bool enable)
+{
+    traceEnabled = enable;
+}
+
+/*********************************************************************
+* Function: TRACE_Clear(void);
+*
+* Overview: Discards all recorded events
+*
+* PreCondition: none
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+void TRACE_Clear(void)
+{
+    traceHead = 0;
+}
+
+/*********************************************************************
+* Function: TRACE_Dump(void);
+*
+* Overview: Streams the ring over UART1 in the binary dump format
+*
+* PreCondition: UART_Initialize()
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+void TRACE_Dump(void)
+{
+    bool wasEnabled = traceEnabled;
+    uint16_t head;
+    uint16_t count;
+    uint16_t index;
+    uint16_t checksum = 0;
+    uint16_t header[3];
+    static const uint8_t magic[4] = { 'T', 'R', 'C', TRACE_DUMP_VERSION };
+
+    // Writers preempt main and finish before it resumes, so once recording
+    // is off the ring is stable
+    traceEnabled = false;
+
+    head = traceHead;
+    count = (head < TRACE_BUFFER_SIZE) ? head : TRACE_BUFFER_SIZE;
+
+    header[0] = count;
+    header[1] = TIME_TICKS_PER_MICRO_SECOND;
+    header[2] = head;
+
+    checksum = TRACE_Send(magic, sizeof(magic), checksum);
+    checksum = TRACE_Send(header, sizeof(header), checksum);
+
+    for (index = head - count; index != head; index++)
+    {
+        checksum = TRACE_Send(&traceBuffer[index & TRACE_BUFFER_MASK], sizeof(TRACE_RECORD), checksum);
+    }
+
+    UART_Write((const uint8_t *)&checksum, sizeof(checksum));
+
+    traceEnabled = wasEnabled;
+}
+
+/*********************************************************************
+* Function: static uint16_t TRACE_Send(const void *data, uint16_t length,
+*                                      uint16_t checksum);
+*
+* Overview: Sends raw bytes (the PIC24 is little endian, so structures go
+*           out in dump byte order) and accumulates the checksum
+*
+* PreCondition: UART_Initialize()
+*
+* Input: data, length - bytes to send
+*        checksum - running checksum
+*
+* Output: updated checksum
+*
+********************************************************************/
+static uint16_t TRACE_Send(const void *data, uint16_t length, uint16_t checksum)
+{
+    const uint8_t *bytes = data;
+    uint16_t i;
+
+    for (i = 0; i < length; i++)
+    {
+        checksum += bytes[i];
+    }
+
+    UART_Write(bytes, length);
+
+    return checksum;
+}
@@ -0,0 +1,130 @@
+/* Microchip Technology Inc. and its subsidiaries.  You may use this software 
+ * and any derivatives exclusively with Microchip products. 
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS".  NO WARRANTIES, WHETHER 
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED 
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A 
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION 
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION. 
+ *
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE, 
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND 
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS 
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE.  TO THE 
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL CLAIMS 
+ * IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF 
+ * ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ *
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE 
+ * TERMS. 
+ */
+
+/* 
+ * File:   trace.h
+ * Author: 
+ * Comments: Binary event trace ring for post-mortem timing analysis
+ * Revision history: 
+ */
+
+// This is a guard condition so that contents of this file are not included
+// more than once.  
+#ifndef TRACE_H
+#define	TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Number of records kept, must be a power of two (8 bytes each) */
+#define TRACE_BUFFER_SIZE       128
+
+/* Binary dump format, all fields little endian:
+ *   'T' 'R' 'C' version          4 bytes
+ *   record count                 uint16_t
+ *   ticks per microsecond        uint16_t
+ *   records written (mod 2^16)   uint16_t
+ *   records, oldest first        count * TRACE_RECORD
+ *   checksum                     uint16_t sum of all preceding bytes
+ * tools/trace_decode.c turns a captured dump back into a listing. */
+#define TRACE_DUMP_VERSION      1
+
+typedef enum
+{
+    TRACE_EVENT_NONE = 0,
+    TRACE_EVENT_UART_SIM_START,     // bit bang frame start bit, arg = data bits
+    TRACE_EVENT_UART_SIM_END,       // bit bang frame last stop bit, arg = data bits
+    TRACE_EVENT_SPI_WORD_DONE,      // SPI1 word sent and SS raised, arg = message index
+    TRACE_EVENT_RTCC_SECOND,        // RTCC 1 Hz alarm, arg = BCD minute:second
+    TRACE_EVENT_ADC_BATCH,          // ADC half buffer read, arg = potentiometer average
+    TRACE_EVENT_USER = 0x80         // first id free for application events
+} TRACE_EVENT;
+
+typedef struct
+{
+    uint16_t id;
+    uint16_t arg;
+    uint32_t timestamp;             // TIME_NowTicks() when the event was recorded
+} TRACE_RECORD;
+
+/*********************************************************************
+* Function: TRACE_Event(uint16_t id, uint16_t arg);
+*
+* Overview: Appends a record to the trace ring, overwriting the oldest
+*           record when full. Safe from main and from interrupts of any
+*           priority; only the slot claim runs with interrupts held off.
+*
+* PreCondition: TIME_Initialize()
+*
+* Input: uint16_t id - TRACE_EVENT or application event id
+*        uint16_t arg - event specific argument
+*
+* Output: none
+*
+********************************************************************/
+void TRACE_Event(uint16_t id, uint16_t arg);
+
+/*********************************************************************
+* Function: TRACE_Enable(bool enable);
+*
+* Overview: Starts or stops recording. Recording is enabled at reset.
+*
+* PreCondition: none
+*
+* Input: bool enable - true to record events
+*
+* Output: none
+*
+********************************************************************/
+void TRACE_Enable(bool enable);
+
+/*********************************************************************
+* Function: TRACE_Clear(void);
+*
+* Overview: Discards all recorded events
+*
+* PreCondition: none
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+void TRACE_Clear(void);
+
+/*********************************************************************
+* Function: TRACE_Dump(void);
+*
+* Overview: Streams the ring over UART1 in the binary dump format.
+*           Recording is paused while the dump is sent. Blocks until
+*           the last byte has been queued.
+*
+* PreCondition: UART_Initialize()
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+void TRACE_Dump(void);
+
+#endif	/* TRACE_H */
+
@@ -6,14 +6,255 @@
  */
 
 #include <xc.h>
+#include <stddef.h>
 #include <uart.h>
+#include <system.h>
+#include <timestamp.h>
+
+/* Transmit queue, drained into the 4-deep hardware FIFO by the UxTX
+ * interrupt. Size must be a power of two. */
+#define UART_TX_QUEUE_SIZE              64
+#define UART_TX_QUEUE_MASK              (UART_TX_QUEUE_SIZE - 1)
+#define UART_TX_INTERRUPT_PRIORITY      2
+
+/* Receive queue, filled by the UxRX interrupt. Size must be a power of two. */
+#define UART_RX_QUEUE_SIZE              32
+#define UART_RX_QUEUE_MASK              (UART_RX_QUEUE_SIZE - 1)
+#define UART_RX_INTERRUPT_PRIORITY      3
+#define UART_ERROR_INTERRUPT_PRIORITY   3 // same as RX, both drain the receive FIFO
+
+/* With flow control the receive interrupt is held off once the queue
+ * reaches the high watermark. The hardware FIFO then fills and RTS is
+ * released, pausing the peer until the application has read the queue
+ * down to the low watermark. */
+#define UART_RX_HIGH_WATERMARK          (UART_RX_QUEUE_SIZE - 8)
+#define UART_RX_LOW_WATERMARK           (UART_RX_QUEUE_SIZE / 4)
+
+/* UxMODE bits */
+#define UART_MODE_UARTEN                0x8000
+#define UART_MODE_RTSMD                 0x0800
+#define UART_MODE_UEN_RTS_CTS           0x0200 // UEN = 10, UxTX, UxRX, UxCTS and UxRTS
+#define UART_MODE_UEN_MASK              0x0300
+#define UART_MODE_LPBACK                0x0040
+#define UART_MODE_ABAUD                 0x0020
+#define UART_MODE_BRGH                  0x0008
+#define UART_MODE_PDSEL_MASK            0x0006
+#define UART_MODE_PDSEL_8_EVEN          0x0002
+#define UART_MODE_PDSEL_8_ODD           0x0004
+#define UART_MODE_PDSEL_9_NONE          0x0006
+#define UART_MODE_STSEL                 0x0001 // two stop bits
+
+/* UxSTA bits */
+#define UART_STA_UTXISEL1               0x8000
+#define UART_STA_UTXINV                 0x4000
+#define UART_STA_UTXISEL0               0x2000
+#define UART_STA_UTXEN                  0x0400
+#define UART_STA_UTXBF                  0x0200
+#define UART_STA_TRMT                   0x0100
+#define UART_STA_ADDEN                  0x0020
+#define UART_STA_PERR                   0x0008
+#define UART_STA_FERR                   0x0004
+#define UART_STA_OERR                   0x0002
+#define UART_STA_URXDA                  0x0001
+
+#define UART_PIN_NONE                   0xFF
+
+#define UART_NINTH_BIT                  0x0100
+
+/* The five registers of each UART are laid out alike from UxMODE */
+typedef struct
+{
+    volatile uint16_t mode;
+    volatile uint16_t sta;
+    volatile uint16_t txreg;
+    volatile uint16_t rxreg;
+    volatile uint16_t brg;
+} UART_REGISTERS;
+
+/* One interrupt source: its enable bit and priority field */
+typedef struct
+{
+    volatile uint16_t *enable;      // IECx
+    volatile uint16_t *priority;    // IPCx
+    uint16_t mask;                  // UxTXIE, UxRXIE or UxERIE
+    uint8_t priorityShift;
+} UART_INTERRUPT;
+
+/* Queues and counters of one UART. The queues hold whole characters,
+ * up to 9 bits. */
+typedef struct
+{
+    uint16_t txQueue[UART_TX_QUEUE_SIZE];
+    volatile uint8_t txHead;
+    volatile uint8_t txTail;
+
+    uint16_t rxQueue[UART_RX_QUEUE_SIZE];
+    volatile uint8_t rxHead;
+    volatile uint8_t rxTail;
+
+    /* Frame format. Mark and space parity are sent as 8 data bits in a
+     * 9-bit frame with the 9th bit fixed; on receive a wrong 9th bit is
+     * a parity error. Only changed with the module off. */
+    uint16_t dataMask;
+    uint16_t ninthBit;
+    bool ninthBitCheck;
+
+    volatile bool profile;
+    volatile bool flowControl;
+    volatile bool multidrop;
+    uint8_t address;
+    volatile bool rxThrottled;
+
+    volatile UART_STATISTICS statistics;
+} UART_STATE;
+
+/* Fixed description of one UART: registers, interrupts and pins. PPS
+ * outputs are selected by writing the function code into the RPORx
+ * byte of the pin, inputs by writing the pin number into the RPINRx
+ * byte of the function. */
+typedef struct
+{
+    UART_REGISTERS *registers;
+    UART_INTERRUPT tx;
+    UART_INTERRUPT rx;
+    UART_INTERRUPT error;
+
+    volatile uint16_t *tris;        // port holding all the pins below
+    uint16_t outputMask;            // TX and RTS
+    uint16_t inputMask;             // RX and CTS
+
+    uint8_t txPin;                  // RPn
+    uint8_t txFunction;
+    volatile uint8_t *rxSelect;     // UxRXR
+    uint8_t rxPin;
+
+    uint8_t rtsPin;                 // UART_PIN_NONE without flow control
+    uint8_t rtsFunction;
+    volatile uint8_t *ctsSelect;    // UxCTSR
+    uint8_t ctsPin;
+
+    UART_STATE *state;
+} UART_PORT;
+
+static UART_STATE uartState[UART_COUNT];
+
+static const UART_PORT uartPorts[UART_COUNT] =
+{
+    {
+        // UART1: TX RP16 (RF3) pin 51, RX RP30 (RF2) pin 52,
+        // RTS RP31 (RF13) pin 39, CTS RPI32 (RF12) pin 40
+        (UART_REGISTERS *)&U1MODE,
+        { &IEC0, &IPC3, 0x1000, 0 },
+        { &IEC0, &IPC2, 0x0800, 12 },
+        { &IEC4, &IPC16, 0x0002, 4 },
+        &TRISF, 0x2008, 0x1004,
+        16, 3, (volatile uint8_t *)&RPINR18, 30,
+        31, 4, (volatile uint8_t *)&RPINR18 + 1, 32,
+        &uartState[UART_ID_1]
+    },
+    {
+        // UART2: TX RP17 (RF5) pin 50, RX RP10 (RF4) pin 49
+        (UART_REGISTERS *)&U2MODE,
+        { &IEC1, &IPC7, 0x8000, 12 },
+        { &IEC1, &IPC7, 0x4000, 8 },
+        { &IEC4, &IPC16, 0x0004, 8 },
+        &TRISF, 0x0020, 0x0010,
+        17, 5, (volatile uint8_t *)&RPINR19, 10,
+        UART_PIN_NONE, 0, NULL, 0,
+        &uartState[UART_ID_2]
+    },
+    {
+        // UART3: TX RP11 (RD0) pin 72, RX RP12 (RD11) pin 71
+        (UART_REGISTERS *)&U3MODE,
+        { &IEC5, &IPC20, 0x0008, 12 },
+        { &IEC5, &IPC20, 0x0004, 8 },
+        { &IEC5, &IPC20, 0x0002, 4 },
+        &TRISD, 0x0001, 0x0800,
+        11, 28, (volatile uint8_t *)&RPINR17 + 1, 12,
+        UART_PIN_NONE, 0, NULL, 0,
+        &uartState[UART_ID_3]
+    },
+    {
+        // UART4: TX RP3 (RD10) pin 70, RX RP4 (RD9) pin 69
+        (UART_REGISTERS *)&U4MODE,
+        { &IEC5, &IPC22, 0x0200, 4 },
+        { &IEC5, &IPC22, 0x0100, 0 },
+        { &IEC5, &IPC21, 0x0080, 12 },
+        &TRISD, 0x0400, 0x0200,
+        3, 30, (volatile uint8_t *)&RPINR27, 4,
+        UART_PIN_NONE, 0, NULL, 0,
+        &uartState[UART_ID_4]
+    },
+};
+
+/* Interrupt time accounting, only while profiling is enabled. The TX
+ * interrupt can be preempted by the RX and error interrupts one level up,
+ * so every profiled handler adds its own time to uartProfileTicks and a
+ * handler that was preempted subtracts what was added meanwhile. */
+typedef struct
+{
+    uint32_t start;                 // TIME_NowTicks() on entry
+    uint32_t nested;                // uartProfileTicks on entry
+} UART_PROFILE_SAMPLE;
+
+#define UART_PROFILE_BEGIN(state, sample)                                   \
+    do {                                                                    \
+        if((state)->profile) { UART_ProfileBegin(&(sample)); }              \
+    } while(0)
+
+#define UART_PROFILE_END(state, sample)                                     \
+    do {                                                                    \
+        if((state)->profile) { UART_ProfileEnd((state), &(sample)); }       \
+    } while(0)
+
+static volatile uint32_t uartProfileTicks;
+
+static void UART_PinsMap(const UART_PORT *port);
+static void UART_InterruptEnable(const UART_INTERRUPT *source, bool enable);
+static void UART_InterruptPrioritySet(const UART_INTERRUPT *source, uint8_t priority);
+static void UART_TxFill(const UART_PORT *port);
+static void UART_TxWaitIdle(const UART_PORT *port);
+static void UART_ModeChange(const UART_PORT *port, uint16_t mask, uint16_t value);
+static bool UART_FormatApply(const UART_PORT *port, uint8_t dataBits, UART_PARITY parity, uint8_t stopBits);
+static uint32_t UART_BaudApply(const UART_PORT *port, uint32_t baud);
+static void UART_RxDrain(const UART_PORT *port);
+static void UART_TxInterrupt(const UART_PORT *port);
+static void UART_RxInterrupt(const UART_PORT *port);
+static void UART_ErrorInterrupt(const UART_PORT *port);
+static void UART_ProfileBegin(UART_PROFILE_SAMPLE *sample);
+static void UART_ProfileEnd(UART_STATE *state, const UART_PROFILE_SAMPLE *sample);
+
+/*********************************************************************
+* Function: UART_PinsInitialize(void);
+*
+* Overview: Maps the pins of all four UARTs
+*
+* PreCondition: PPS registers unlocked
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+void UART_PinsInitialize(void)
+{
+    UART_ID id;
+
+    /* Every UART is mapped up front because the mapping can not be
+     * changed later (IOL1WAY). UART1 flow control pins are mapped too;
+     * UART_FlowControlEnable() only switches UEN. */
+    for(id = UART_ID_1; id < UART_COUNT; id++)
+    {
+        UART_PinsMap(&uartPorts[id]);
+    }
+}
 
 /*********************************************************************
 * Function: UART_Initialize(void);
 *
-* Overview: Initializes UART
+* Overview: Initializes UART1
 *
-* PreCondition: none
+* PreCondition: UART_PinsInitialize()
 *
 * Input: none
 *
@@ -22,43 +263,90 @@
 ********************************************************************/
 void UART_Initialize(void)
 {
-    TRISFbits.TRISF3 = 0; // RF3 as output (U1TX) pin 51
-    
-    // Unlock Registers
-    __builtin_write_OSCCONL(OSCCON & 0xBF);
-    
-    RPOR8bits.RP16R = 3; // RP16 -> U1TX (RF3) pin 51
-    
-    // Lock Registers
-    __builtin_write_OSCCONL(OSCCON | 0x40);    
-    
-    U1STA = 0; // initial reset
-    U1MODE = 0x8000; //Enable Uart for 8-bit data, no parity, 1 STOP bit
-    U1BRG = 25; //Set Baudrate ((FCY/Desired Baud Rate)/16) ? 1 => ((4000000/9600)/16) - 1
+    UART_InstanceInitialize(UART_ID_1, UART_DEFAULT_BAUD);
+}
+
+/*********************************************************************
+* Function: UART_InstanceInitialize(UART_ID id, uint32_t baud);
+*
+* Overview: Initializes one UART for 8-bit data, no parity, 1 stop bit
+*
+* PreCondition: UART_PinsInitialize()
+*
+* Input: UART_ID id - UART to initialize
+*        uint32_t baud - bit rate
+*
+* Output: true if initialized, false for an unknown UART or a bit rate
+*         out of range
+*
+********************************************************************/
+bool UART_InstanceInitialize(UART_ID id, uint32_t baud)
+{
+    const UART_PORT *port;
+    UART_REGISTERS *registers;
+    UART_STATE *state;
+
+    if(id >= UART_COUNT)
+    {
+        return false;
+    }
+
+    port = &uartPorts[id];
+    registers = port->registers;
+    state = port->state;
+
+    UART_InterruptEnable(&port->tx, false);
+    UART_InterruptEnable(&port->rx, false);
+    UART_InterruptEnable(&port->error, false);
+
+    *port->tris &= ~port->outputMask;
+    *port->tris |= port->inputMask;
+
+    registers->sta = 0; // initial reset
+    registers->mode = UART_MODE_UARTEN; //Enable Uart for 8-bit data, no parity, 1 STOP bit
+    if(UART_BaudApply(port, baud) == 0)
+    {
+        registers->mode = 0;
+        return false;
+    }
     
     /* Once enabled, the UxTX and UxRX pins are configured as an output and an 
      * input, respectively, overriding the TRIS and PORT register bit settings 
-     * for the corresponding I/O port pins (pin 51 TX / 52 RX). The UxTX pin is 
-     * at logic ?1? when no transmission is taking place. The UxTXIF bit will 
-     * be set when the module is first enabled*/
+     * for the corresponding I/O port pins. The UxTX pin is at logic ?1? when
+     * no transmission is taking place. The UxTXIF bit will be set when the
+     * module is first enabled, the interrupt finds the queue empty and
+     * turns itself off again. */
     
-    //IFS0bits.U1TXIF = 0; // The user should clear the UxTXIF bit in the ISR.     
-    //IEC0bits.U1TXIE = 1; //Enable Transmit Interrupt
+    state->txHead = 0;
+    state->txTail = 0;
+    state->rxHead = 0;
+    state->rxTail = 0;
+    state->profile = false;
+    state->flowControl = false;
+    state->multidrop = false;
+    state->rxThrottled = false;
+    state->dataMask = 0xFF;
+    state->ninthBit = 0;
+    state->ninthBitCheck = false;
+    state->statistics = (UART_STATISTICS){0};
+
+    // TX is enabled by UART_PutChar() while the queue holds data
+    UART_InterruptPrioritySet(&port->tx, UART_TX_INTERRUPT_PRIORITY);
+    UART_InterruptPrioritySet(&port->rx, UART_RX_INTERRUPT_PRIORITY);
+    UART_InterruptPrioritySet(&port->error, UART_ERROR_INTERRUPT_PRIORITY);
+    UART_InterruptEnable(&port->rx, true); // URXISEL = 00, interrupt on every received character
+    UART_InterruptEnable(&port->error, true); // Overrun, framing and parity errors
     
     /* The UTXEN bit should not be set until the UARTEN bit has been set; 
-     * otherwise, UART transmissions will not be enabled. */
-    U1STAbits.UTXINV = 1; // UxTX Idle state is ?1?
-    U1STAbits.UTXEN = 1; // Enable UART module
-    
-    /* The Transmit Interrupt Flag (UxTXIF) is located in the corresponding 
-     * Interrupt Flag Status (IFS) register. The UTXISEL<1:0> control bits 
-     * (UxSTA<15,13>) determine when the UART will generate a transmit 
-     * interrupt. 
-     * 
-     * UTXISEL<1:0> = 10, the UxTXIF is set when the character is transferred to 
-     * the Transmit Shift register (UxTSR) and the transmit buffer is empty*/
-    //U1STAbits.UTXISEL0 = 0;
-    //U1STAbits.UTXISEL1 = 1;
+     * otherwise, UART transmissions will not be enabled.
+     *
+     * UTXINV = 0, the UxTX Idle state is ?1?.
+     *
+     * UTXISEL<1:0> = 00, the UxTXIF is set when a character is transferred to 
+     * the Transmit Shift register (UxTSR), i.e. a buffer slot has come free*/
+    registers->sta = UART_STA_UTXEN;
+
+    return true;
 }
 
 /*********************************************************************
@@ -75,15 +363,1113 @@ void UART_Initialize(void)
 ********************************************************************/
 void UART_Transmit(void)
 {
-    U1TXREG = 0xAA;
+    UART_PutChar(0xAA);
+}
+
+/*********************************************************************
+* Function: UART_InstancePutChar(UART_ID id, uint8_t data);
+*
+* Overview: Queues one byte for transmission, waiting for room in the
+*           transmit queue
+*
+* PreCondition: UART_InstanceInitialize()
+*
+* Input: UART_ID id - UART to send on
+*        uint8_t data - byte to send
+*
+* Output: none
+*
+********************************************************************/
+void UART_InstancePutChar(UART_ID id, uint8_t data)
+{
+    UART_InstancePutWord(id, data);
+}
+
+/*********************************************************************
+* Function: UART_InstancePutWord(UART_ID id, uint16_t data);
+*
+* Overview: Queues one character of up to 9 data bits for transmission,
+*           waiting for room in the transmit queue
+*
+* PreCondition: UART_InstanceInitialize()
+*
+* Input: UART_ID id - UART to send on
+*        uint16_t data - character to send, bits above the data bits
+*                        are ignored
+*
+* Output: none
+*
+********************************************************************/
+void UART_InstancePutWord(UART_ID id, uint16_t data)
+{
+    const UART_PORT *port = &uartPorts[id];
+    UART_STATE *state = port->state;
+    uint16_t ipl;
+    uint8_t next;
+
+    data = (data & state->dataMask) | state->ninthBit;
+
+    while(1)
+    {
+        SET_AND_SAVE_CPU_IPL(ipl, 7);
+
+        next = (state->txHead + 1) & UART_TX_QUEUE_MASK;
+        if(next != state->txTail)
+        {
+            state->txQueue[state->txHead] = data;
+            state->txHead = next;
+            state->statistics.txBytes++;
+
+            // Prime the hardware FIFO, the interrupt takes over from there
+            UART_TxFill(port);
+            if(state->txHead != state->txTail)
+            {
+                UART_InterruptEnable(&port->tx, true);
+            }
+
+            RESTORE_CPU_IPL(ipl);
+            return;
+        }
+
+        RESTORE_CPU_IPL(ipl);
+
+        /* Queue full. A caller at or above the TX interrupt priority would
+         * wait forever, so it drains the queue itself by polling */
+        if(ipl >= UART_TX_INTERRUPT_PRIORITY)
+        {
+            SET_AND_SAVE_CPU_IPL(ipl, 7);
+            UART_TxFill(port);
+            RESTORE_CPU_IPL(ipl);
+        }
+    }
+}
+
+/*********************************************************************
+* Function: UART_InstanceWrite(UART_ID id, const uint8_t *data,
+*                              uint16_t length);
+*
+* Overview: Transmits a block of bytes
+*
+* PreCondition: UART_InstanceInitialize()
+*
+* Input: UART_ID id - UART to send on
+*        const uint8_t *data - bytes to send
+*        uint16_t length - number of bytes
+*
+* Output: none
+*
+********************************************************************/
+void UART_InstanceWrite(UART_ID id, const uint8_t *data, uint16_t length)
+{
+    while(length--)
+    {
+        UART_InstancePutChar(id, *data++);
+    }
+}
+
+/*********************************************************************
+* Function: UART_InstanceGetChar(UART_ID id, uint8_t *data);
+*
+* Overview: Takes the oldest received byte from the receive queue
+*
+* PreCondition: UART_InstanceInitialize()
+*
+* Input: UART_ID id - UART to read
+*        uint8_t *data - where to store the byte
+*
+* Output: true if a byte was returned, false if the queue is empty
+*
+********************************************************************/
+bool UART_InstanceGetChar(UART_ID id, uint8_t *data)
+{
+    uint16_t character;
+
+    if(!UART_InstanceGetWord(id, &character))
+    {
+        return false;
+    }
+
+    *data = (uint8_t)character;
+    return true;
+}
+
+/*********************************************************************
+* Function: UART_InstanceGetWord(UART_ID id, uint16_t *data);
+*
+* Overview: Takes the oldest received character from the receive queue
+*
+* PreCondition: UART_InstanceInitialize()
+*
+* Input: UART_ID id - UART to read
+*        uint16_t *data - where to store the character
+*
+* Output: true if a character was returned, false if the queue is empty
+*
+********************************************************************/
+bool UART_InstanceGetWord(UART_ID id, uint16_t *data)
+{
+    const UART_PORT *port = &uartPorts[id];
+    UART_STATE *state = port->state;
+    uint8_t tail = state->rxTail;
+
+    if(tail == state->rxHead)
+    {
+        return false;
+    }
+
+    *data = state->rxQueue[tail];
+    tail = (tail + 1) & UART_RX_QUEUE_MASK;
+    state->rxTail = tail;
+
+    if(state->rxThrottled && (((state->rxHead - tail) & UART_RX_QUEUE_MASK) <= UART_RX_LOW_WATERMARK))
+    {
+        // RX flag stayed set while disabled, so the FIFO is drained straight away
+        state->rxThrottled = false;
+        UART_InterruptEnable(&port->rx, true);
+    }
+
+    return true;
+}
+
+/*********************************************************************
+* Function: UART_InstanceFlowControlEnable(UART_ID id, bool enable);
+*
+* Overview: Waits for queued data to be sent, then switches RTS/CTS
+*           hardware flow control on or off
+*
+* PreCondition: UART_InstanceInitialize(), not called from an interrupt
+*
+* Input: UART_ID id - UART to configure
+*        bool enable - true for RTS/CTS, false for TX/RX only
+*
+* Output: false if flow control was requested on a UART without the
+*         pins for it
+*
+********************************************************************/
+bool UART_InstanceFlowControlEnable(UART_ID id, bool enable)
+{
+    const UART_PORT *port = &uartPorts[id];
+
+    if(port->rtsPin == UART_PIN_NONE)
+    {
+        return (enable == false);
+    }
+
+    // Turning the module off to switch UEN would drop queued output
+    UART_TxWaitIdle(port);
+
+    port->state->flowControl = enable;
+
+    // RTSMD = 0, RTS signals receiver ready, not simplex direction
+    UART_ModeChange(port, UART_MODE_UEN_MASK | UART_MODE_RTSMD,
+                    enable ? UART_MODE_UEN_RTS_CTS : 0);
+
+    return true;
+}
+
+/*********************************************************************
+* Function: UART_InstanceSetFormat(UART_ID id, uint8_t dataBits,
+*                                  UART_PARITY parity, uint8_t stopBits);
+*
+* Overview: Sets the frame format through PDSEL and STSEL
+*
+* PreCondition: UART_InstanceInitialize(), not called from an interrupt
+*
+* Input: UART_ID id - UART to configure
+*        uint8_t dataBits - 8 or 9
+*        UART_PARITY parity - any with 8 data bits, none with 9
+*        uint8_t stopBits - 1 or 2
+*
+* Output: true if applied, false if the hardware cannot send the format
+*         or multidrop is on
+*
+********************************************************************/
+bool UART_InstanceSetFormat(UART_ID id, uint8_t dataBits, UART_PARITY parity, uint8_t stopBits)
+{
+    const UART_PORT *port = &uartPorts[id];
+
+    /* Multidrop owns the format, and ADDEN would stay set under any
+     * other. It is left through UART_InstanceMultidropEnable(). */
+    if(port->state->multidrop)
+    {
+        return false;
+    }
+
+    return UART_FormatApply(port, dataBits, parity, stopBits);
+}
+
+/*********************************************************************
+* Function: UART_FormatApply(const UART_PORT *port, uint8_t dataBits,
+*                            UART_PARITY parity, uint8_t stopBits);
+*
+* Overview: Body of UART_InstanceSetFormat(), without the multidrop check
+*
+* PreCondition: UART_InstanceInitialize(), not called from an interrupt
+*
+* Input: const UART_PORT *port - UART to configure
+*        uint8_t dataBits - 8 or 9
+*        UART_PARITY parity - any with 8 data bits, none with 9
+*        uint8_t stopBits - 1 or 2
+*
+* Output: true if applied, false if the hardware cannot send the format
+*
+********************************************************************/
+static bool UART_FormatApply(const UART_PORT *port, uint8_t dataBits, UART_PARITY parity, uint8_t stopBits)
+{
+    UART_STATE *state = port->state;
+    uint16_t mode;
+    uint16_t dataMask = 0xFF;
+    uint16_t ninthBit = 0;
+    bool ninthBitCheck = false;
+
+    if((stopBits < 1) || (stopBits > 2))
+    {
+        return false;
+    }
+
+    if(dataBits == 9)
+    {
+        if(parity != UART_PARITY_NONE)
+        {
+            return false;
+        }
+        mode = UART_MODE_PDSEL_9_NONE;
+        dataMask = 0x1FF;
+    }
+    else if(dataBits == 8)
+    {
+        switch(parity)
+        {
+            case UART_PARITY_NONE:
+                mode = 0;
+                break;
+
+            case UART_PARITY_EVEN:
+                mode = UART_MODE_PDSEL_8_EVEN;
+                break;
+
+            case UART_PARITY_ODD:
+                mode = UART_MODE_PDSEL_8_ODD;
+                break;
+
+            case UART_PARITY_MARK:
+            case UART_PARITY_SPACE:
+                mode = UART_MODE_PDSEL_9_NONE;
+                ninthBit = (parity == UART_PARITY_MARK) ? UART_NINTH_BIT : 0;
+                ninthBitCheck = true;
+                break;
+
+            default:
+                return false;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    if(stopBits == 2)
+    {
+        mode |= UART_MODE_STSEL;
+    }
+
+    UART_TxWaitIdle(port);
+
+    state->dataMask = dataMask;
+    state->ninthBit = ninthBit;
+    state->ninthBitCheck = ninthBitCheck;
+
+    UART_ModeChange(port, UART_MODE_PDSEL_MASK | UART_MODE_STSEL, mode);
+
+    return true;
+}
+
+/*********************************************************************
+* Function: UART_InstanceMultidropEnable(UART_ID id, bool enable,
+*                                        uint8_t address);
+*
+* Overview: Switches 9-bit multidrop reception with hardware address
+*           detection (ADDEN) on or off
+*
+* PreCondition: UART_InstanceInitialize(), not called from an interrupt
+*
+* Input: UART_ID id - UART to configure
+*        bool enable - true for multidrop, false for 8 data bits
+*        uint8_t address - this node, not UART_MULTIDROP_BROADCAST
+*
+* Output: true if applied
+*
+********************************************************************/
+bool UART_InstanceMultidropEnable(UART_ID id, bool enable, uint8_t address)
+{
+    const UART_PORT *port = &uartPorts[id];
+    UART_STATE *state = port->state;
+    uint8_t stopBits = (port->registers->mode & UART_MODE_STSEL) ? 2 : 1;
+    uint16_t ipl;
+
+    if(enable && (address == UART_MULTIDROP_BROADCAST))
+    {
+        return false;
+    }
+
+    if(!UART_FormatApply(port, enable ? 9 : 8, UART_PARITY_NONE, stopBits))
+    {
+        return false;
+    }
+
+    // UxSTA is also written by the receive interrupt
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    state->address = address;
+    state->multidrop = enable;
+    if(enable)
+    {
+        port->registers->sta |= UART_STA_ADDEN;
+    }
+    else
+    {
+        port->registers->sta &= ~UART_STA_ADDEN;
+    }
+    RESTORE_CPU_IPL(ipl);
+
+    return true;
+}
+
+/*********************************************************************
+* Function: UART_InstanceSendAddress(UART_ID id, uint8_t address);
+*
+* Overview: Queues an address character (9th bit set), starting a
+*           multidrop frame
+*
+* PreCondition: UART_InstanceMultidropEnable() or 9 data bits
+*
+* Input: UART_ID id - UART to send on
+*        uint8_t address - destination node or UART_MULTIDROP_BROADCAST
+*
+* Output: none
+*
+********************************************************************/
+void UART_InstanceSendAddress(UART_ID id, uint8_t address)
+{
+    UART_InstancePutWord(id, UART_NINTH_BIT | address);
+}
+
+/*********************************************************************
+* Function: UART_InstanceStatisticsGet(UART_ID id,
+*                                      UART_STATISTICS *statistics);
+*
+* Overview: Copies the transfer and error counters
+*
+* PreCondition: UART_InstanceInitialize()
+*
+* Input: UART_ID id - UART to report
+*        UART_STATISTICS *statistics - where to copy the counters
+*
+* Output: none
+*
+********************************************************************/
+void UART_InstanceStatisticsGet(UART_ID id, UART_STATISTICS *statistics)
+{
+    uint16_t ipl;
+
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    *statistics = uartPorts[id].state->statistics;
+    RESTORE_CPU_IPL(ipl);
+}
+
+/*********************************************************************
+* Function: UART_InstanceSetBaud(UART_ID id, uint32_t baud);
+*
+* Overview: Waits for queued data to be sent, then switches the bit rate
+*
+* PreCondition: UART_InstanceInitialize(), not called from an interrupt
+*
+* Input: UART_ID id - UART to configure
+*        uint32_t baud - requested bit rate
+*
+* Output: uint32_t - bit rate actually set, 0 if out of range
+*
+********************************************************************/
+uint32_t UART_InstanceSetBaud(UART_ID id, uint32_t baud)
+{
+    UART_TxWaitIdle(&uartPorts[id]);
+
+    return UART_BaudApply(&uartPorts[id], baud);
+}
+
+/*********************************************************************
+* Function: UART_InstanceGetBaud(UART_ID id);
+*
+* Overview: Returns the bit rate set by UxBRG and BRGH
+*
+* PreCondition: UART_InstanceInitialize()
+*
+* Input: UART_ID id - UART to report
+*
+* Output: uint32_t - current bit rate
+*
+********************************************************************/
+uint32_t UART_InstanceGetBaud(UART_ID id)
+{
+    UART_REGISTERS *registers = uartPorts[id].registers;
+    uint32_t divisor = (registers->mode & UART_MODE_BRGH) ? 4 : 16;
+
+    return SYSTEM_PERIPHERAL_CLOCK / (divisor * ((uint32_t)registers->brg + 1));
+}
+
+/*********************************************************************
+* Function: UART_InstanceAutoBaudStart(UART_ID id);
+*
+* Overview: Arms auto-baud detection
+*
+* PreCondition: UART_InstanceInitialize(), not called from an interrupt
+*
+* Input: UART_ID id - UART to measure
+*
+* Output: none
+*
+********************************************************************/
+void UART_InstanceAutoBaudStart(UART_ID id)
+{
+    UART_TxWaitIdle(&uartPorts[id]);
+
+    /* BRGH = 1 measures the sync character with 4x finer resolution,
+     * which matters at high rates with a 4 MHz FCY */
+    uartPorts[id].registers->mode |= UART_MODE_BRGH;
+    uartPorts[id].registers->mode |= UART_MODE_ABAUD;
+}
+
+/*********************************************************************
+* Function: UART_InstanceAutoBaudComplete(UART_ID id);
+*
+* Overview: Reports whether the sync character has been measured
+*
+* PreCondition: UART_InstanceAutoBaudStart()
+*
+* Input: UART_ID id - UART to check
+*
+* Output: true once UxBRG holds the measured rate
+*
+********************************************************************/
+bool UART_InstanceAutoBaudComplete(UART_ID id)
+{
+    return ((uartPorts[id].registers->mode & UART_MODE_ABAUD) == 0);
+}
+
+/*********************************************************************
+* Function: UART_InstanceLoopbackEnable(UART_ID id, bool enable);
+*
+* Overview: Connects the transmitter to the receiver internally (LPBACK)
+*
+* PreCondition: UART_InstanceInitialize(), not called from an interrupt
+*
+* Input: UART_ID id - UART to configure
+*        bool enable - true for loopback, false for the pins
+*
+* Output: none
+*
+********************************************************************/
+void UART_InstanceLoopbackEnable(UART_ID id, bool enable)
+{
+    UART_REGISTERS *registers = uartPorts[id].registers;
+
+    UART_TxWaitIdle(&uartPorts[id]);
+
+    if(enable)
+    {
+        registers->mode |= UART_MODE_LPBACK;
+    }
+    else
+    {
+        registers->mode &= ~UART_MODE_LPBACK;
+    }
+}
+
+/*********************************************************************
+* Function: UART_InstanceProfileEnable(UART_ID id, bool enable);
+*
+* Overview: Starts or stops accumulating UART interrupt time in
+*           UART_STATISTICS.isrTicks
+*
+* PreCondition: UART_InstanceInitialize(), TIME_Initialize()
+*
+* Input: UART_ID id - UART to measure
+*        bool enable - true to measure
+*
+* Output: none
+*
+********************************************************************/
+void UART_InstanceProfileEnable(UART_ID id, bool enable)
+{
+    uartPorts[id].state->profile = enable;
+}
+
+/*********************************************************************
+* UART1 interface, kept for the console and diagnostics code
+********************************************************************/
+void UART_PutChar(uint8_t data)
+{
+    UART_InstancePutWord(UART_ID_1, data);
+}
+
+void UART_Write(const uint8_t *data, uint16_t length)
+{
+    UART_InstanceWrite(UART_ID_1, data, length);
+}
+
+bool UART_GetChar(uint8_t *data)
+{
+    return UART_InstanceGetChar(UART_ID_1, data);
+}
+
+void UART_FlowControlEnable(bool enable)
+{
+    UART_InstanceFlowControlEnable(UART_ID_1, enable);
+}
+
+bool UART_SetFormat(uint8_t dataBits, UART_PARITY parity, uint8_t stopBits)
+{
+    return UART_InstanceSetFormat(UART_ID_1, dataBits, parity, stopBits);
+}
+
+void UART_StatisticsGet(UART_STATISTICS *statistics)
+{
+    UART_InstanceStatisticsGet(UART_ID_1, statistics);
+}
+
+uint32_t UART_SetBaud(uint32_t baud)
+{
+    return UART_InstanceSetBaud(UART_ID_1, baud);
+}
+
+uint32_t UART_GetBaud(void)
+{
+    return UART_InstanceGetBaud(UART_ID_1);
+}
+
+void UART_AutoBaudStart(void)
+{
+    UART_InstanceAutoBaudStart(UART_ID_1);
+}
+
+bool UART_AutoBaudComplete(void)
+{
+    return UART_InstanceAutoBaudComplete(UART_ID_1);
+}
+
+void UART_LoopbackEnable(bool enable)
+{
+    UART_InstanceLoopbackEnable(UART_ID_1, enable);
+}
+
+void UART_ProfileEnable(bool enable)
+{
+    UART_InstanceProfileEnable(UART_ID_1, enable);
+}
+
+/*********************************************************************
+* Function: UART_PinsMap(const UART_PORT *port);
+*
+* Overview: Routes the UART's pins through the peripheral pin select
+*
+* PreCondition: PPS registers unlocked
+*
+* Input: const UART_PORT *port - UART to map
+*
+* Output: none
+*
+********************************************************************/
+static void UART_PinsMap(const UART_PORT *port)
+{
+    volatile uint8_t *outputs = (volatile uint8_t *)&RPOR0;
+
+    outputs[port->txPin] = port->txFunction;
+    *port->rxSelect = port->rxPin;
+
+    if(port->rtsPin != UART_PIN_NONE)
+    {
+        outputs[port->rtsPin] = port->rtsFunction;
+        *port->ctsSelect = port->ctsPin;
+    }
+}
+
+/*********************************************************************
+* Function: UART_InterruptEnable(const UART_INTERRUPT *source,
+*                                bool enable);
+*
+* Overview: Sets or clears an interrupt enable bit. The IECx registers
+*           are shared with other peripherals and the mask is not a
+*           constant, so the read-modify-write is done with interrupts
+*           held off.
+*
+* PreCondition: none
+*
+* Input: const UART_INTERRUPT *source - interrupt to change
+*        bool enable - true to enable
+*
+* Output: none
+*
+********************************************************************/
+static void UART_InterruptEnable(const UART_INTERRUPT *source, bool enable)
+{
+    uint16_t ipl;
+
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    if(enable)
+    {
+        *source->enable |= source->mask;
+    }
+    else
+    {
+        *source->enable &= ~source->mask;
+    }
+    RESTORE_CPU_IPL(ipl);
+}
+
+/*********************************************************************
+* Function: UART_InterruptPrioritySet(const UART_INTERRUPT *source,
+*                                     uint8_t priority);
+*
+* Overview: Writes an interrupt priority field
+*
+* PreCondition: none
+*
+* Input: const UART_INTERRUPT *source - interrupt to change
+*        uint8_t priority - 0 to 7
+*
+* Output: none
+*
+********************************************************************/
+static void UART_InterruptPrioritySet(const UART_INTERRUPT *source, uint8_t priority)
+{
+    uint16_t ipl;
+
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    *source->priority = (*source->priority & ~(7 << source->priorityShift)) |
+                        ((uint16_t)priority << source->priorityShift);
+    RESTORE_CPU_IPL(ipl);
+}
+
+/*********************************************************************
+* Function: UART_TxWaitIdle(const UART_PORT *port);
+*
+* Overview: Waits until the transmit queue, the hardware buffer and the
+*           shift register are all empty
+*
+* PreCondition: Called at a priority below the TX interrupt
+*
+* Input: const UART_PORT *port - UART to wait for
+*
+* Output: none
+*
+********************************************************************/
+static void UART_TxWaitIdle(const UART_PORT *port)
+{
+    while((port->state->txHead != port->state->txTail) ||
+          !(port->registers->sta & UART_STA_TRMT)) {}
+}
+
+/*********************************************************************
+* Function: UART_ModeChange(const UART_PORT *port, uint16_t mask,
+*                           uint16_t value);
+*
+* Overview: Rewrites UxMODE fields that may only change while the
+*           module is off (UEN, PDSEL, STSEL). Characters already in the
+*           receive FIFO are moved to the receive queue first; one that
+*           arrives while the module is off is lost.
+*
+* PreCondition: UART_TxWaitIdle()
+*
+* Input: const UART_PORT *port - UART to configure
+*        uint16_t mask - UxMODE bits to change
+*        uint16_t value - their new value
+*
+* Output: none
+*
+********************************************************************/
+static void UART_ModeChange(const UART_PORT *port, uint16_t mask, uint16_t value)
+{
+    UART_REGISTERS *registers = port->registers;
+    uint16_t mode;
+    uint16_t ipl;
+
+    /* Clearing UARTEN resets the receive FIFO, so it is drained with the
+     * RX and error interrupts held off. The masked fields are cleared in
+     * the saved value itself, so the write back cannot restore them. */
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    UART_RxDrain(port);
+    mode = registers->mode & ~(UART_MODE_UARTEN | mask);
+    registers->mode = mode;
+
+    registers->mode = mode | value | UART_MODE_UARTEN;
+    registers->sta |= UART_STA_UTXEN; // cleared with UARTEN
+    RESTORE_CPU_IPL(ipl);
+}
+
+/*********************************************************************
+* Function: UART_BaudApply(const UART_PORT *port, uint32_t baud);
+*
+* Overview: Picks the BRGH setting and UxBRG value closest to the
+*           requested rate and writes them. Both the 16x (BRGH = 0) and
+*           4x (BRGH = 1) clocks are evaluated with a rounded divisor;
+*           on a tie the 16x clock is kept for its better noise
+*           rejection.
+*
+* PreCondition: none
+*
+* Input: const UART_PORT *port - UART to configure
+*        uint32_t baud - requested bit rate
+*
+* Output: uint32_t - bit rate actually set, 0 if out of range
+*
+********************************************************************/
+static uint32_t UART_BaudApply(const UART_PORT *port, uint32_t baud)
+{
+    static const uint8_t divisors[2] = { 16, 4 }; // BRGH = 0, BRGH = 1
+    uint32_t brg;
+    uint32_t actual;
+    uint32_t error;
+    uint32_t bestError = 0xFFFFFFFFUL;
+    uint32_t bestActual = 0;
+    uint16_t bestBrg = 0;
+    uint8_t bestBrgh = 0;
+    uint8_t brgh;
+
+    if((baud == 0) || (baud > (SYSTEM_PERIPHERAL_CLOCK / 4)))
+    {
+        return 0;
+    }
+
+    for(brgh = 0; brgh < 2; brgh++)
+    {
+        brg = (SYSTEM_PERIPHERAL_CLOCK + ((uint32_t)divisors[brgh] * baud / 2)) /
+              ((uint32_t)divisors[brgh] * baud);
+        if(brg == 0)
+        {
+            brg = 1;
+        }
+        if(brg > 0x10000UL)
+        {
+            continue;
+        }
+
+        actual = SYSTEM_PERIPHERAL_CLOCK / ((uint32_t)divisors[brgh] * brg);
+        error = (actual > baud) ? (actual - baud) : (baud - actual);
+
+        if(error < bestError)
+        {
+            bestError = error;
+            bestActual = actual;
+            bestBrg = (uint16_t)(brg - 1);
+            bestBrgh = brgh;
+        }
+    }
+
+    if(bestActual != 0)
+    {
+        if(bestBrgh)
+        {
+            port->registers->mode |= UART_MODE_BRGH;
+        }
+        else
+        {
+            port->registers->mode &= ~UART_MODE_BRGH;
+        }
+        port->registers->brg = bestBrg;
+    }
+
+    return bestActual;
+}
+
+/*********************************************************************
+* Function: UART_TxFill(const UART_PORT *port);
+*
+* Overview: Moves queued bytes into the hardware transmit buffer until
+*           it is full or the queue is empty
+*
+* PreCondition: Called from the TX interrupt or with interrupts held off
+*
+* Input: const UART_PORT *port - UART to fill
+*
+* Output: none
+*
+********************************************************************/
+static void UART_TxFill(const UART_PORT *port)
+{
+    UART_REGISTERS *registers = port->registers;
+    UART_STATE *state = port->state;
+    uint8_t tail = state->txTail;
+
+    while(!(registers->sta & UART_STA_UTXBF) && (tail != state->txHead))
+    {
+        registers->txreg = state->txQueue[tail];
+        tail = (tail + 1) & UART_TX_QUEUE_MASK;
+    }
+
+    state->txTail = tail;
+}
+
+/*********************************************************************
+* Function: UART_RxDrain(const UART_PORT *port);
+*
+* Overview: Moves received characters from the hardware FIFO into the
+*           receive queue. Characters with a framing or parity error are
+*           counted and discarded. With flow control the receive
+*           interrupt is held off at the high watermark.
+*
+* PreCondition: Called from the RX or error interrupt (same priority),
+*               or with both held off
+*
+* Input: const UART_PORT *port - UART to drain
+*
+* Output: none
+*
+********************************************************************/
+static void UART_RxDrain(const UART_PORT *port)
+{
+    UART_REGISTERS *registers = port->registers;
+    UART_STATE *state = port->state;
+    uint8_t head = state->rxHead;
+    uint8_t next;
+    uint16_t data;
+    uint16_t status;
 
-    while(U1STAbits.UTXBF) {} // The UTXBF (UxSTA<9>) status bit is set whenever the buffer is full
+    while((status = registers->sta) & UART_STA_URXDA)
+    {
+        /* FERR and PERR describe the character at the top of the FIFO and
+         * are cleared by reading it */
+        if(status & UART_STA_FERR)
+        {
+            state->statistics.framingErrors++;
+            (void)registers->rxreg;
+            continue;
+        }
+        if(status & UART_STA_PERR)
+        {
+            state->statistics.parityErrors++;
+            (void)registers->rxreg;
+            continue;
+        }
+
+        data = registers->rxreg;
+
+        /* Multidrop: ADDEN hides data characters from the FIFO entirely.
+         * An address for this node clears it to take the frame's data,
+         * any other address sets it again. Address characters are queued
+         * with the 9th bit set so the application sees frame starts. */
+        if(state->multidrop && (data & UART_NINTH_BIT))
+        {
+            if(((uint8_t)data == state->address) || ((uint8_t)data == UART_MULTIDROP_BROADCAST))
+            {
+                registers->sta &= ~UART_STA_ADDEN;
+                state->statistics.addressFrames++;
+            }
+            else
+            {
+                registers->sta |= UART_STA_ADDEN;
+                continue;
+            }
+        }
+
+        if(state->ninthBitCheck)
+        {
+            if((data & UART_NINTH_BIT) != state->ninthBit)
+            {
+                state->statistics.parityErrors++; // mark or space parity
+                continue;
+            }
+            data &= state->dataMask;
+        }
+
+        state->statistics.rxBytes++;
+
+        next = (head + 1) & UART_RX_QUEUE_MASK;
+        if(next == state->rxTail)
+        {
+            state->statistics.rxDropped++; // queue full, the application is not keeping up
+        }
+        else
+        {
+            state->rxQueue[head] = data;
+            head = next;
+        }
+    }
+
+    state->rxHead = head;
+
+    if(state->flowControl && (((head - state->rxTail) & UART_RX_QUEUE_MASK) >= UART_RX_HIGH_WATERMARK))
+    {
+        state->rxThrottled = true;
+        UART_InterruptEnable(&port->rx, false);
+    }
+}
+
+/*********************************************************************
+* Function: UART_TxInterrupt(const UART_PORT *port);
+*
+* Overview: Body of the UxTX interrupt, a buffer slot has come free
+*
+* PreCondition: UxTXIF already cleared
+*
+* Input: const UART_PORT *port - interrupting UART
+*
+* Output: none
+*
+********************************************************************/
+static void UART_TxInterrupt(const UART_PORT *port)
+{
+    UART_STATE *state = port->state;
+    UART_PROFILE_SAMPLE sample;
+
+    UART_PROFILE_BEGIN(state, sample);
+
+    state->statistics.txInterrupts++;
+
+    UART_TxFill(port);
+
+    if(state->txHead == state->txTail)
+    {
+        UART_InterruptEnable(&port->tx, false); // queue drained, re-enabled by UART_PutChar()
+    }
+
+    UART_PROFILE_END(state, sample);
+}
+
+/*********************************************************************
+* Function: UART_RxInterrupt(const UART_PORT *port);
+*
+* Overview: Body of the UxRX interrupt, a character was received
+*
+* PreCondition: UxRXIF already cleared
+*
+* Input: const UART_PORT *port - interrupting UART
+*
+* Output: none
+*
+********************************************************************/
+static void UART_RxInterrupt(const UART_PORT *port)
+{
+    UART_STATE *state = port->state;
+    UART_PROFILE_SAMPLE sample;
+
+    UART_PROFILE_BEGIN(state, sample);
+
+    state->statistics.rxInterrupts++;
+
+    UART_RxDrain(port);
+
+    UART_PROFILE_END(state, sample);
+}
+
+/*********************************************************************
+* Function: UART_ErrorInterrupt(const UART_PORT *port);
+*
+* Overview: Body of the UxErr interrupt, overrun (OERR), framing (FERR)
+*           or parity (PERR)
+*
+* PreCondition: UxERIF already cleared
+*
+* Input: const UART_PORT *port - interrupting UART
+*
+* Output: none
+*
+********************************************************************/
+static void UART_ErrorInterrupt(const UART_PORT *port)
+{
+    UART_STATE *state = port->state;
+    UART_PROFILE_SAMPLE sample;
+
+    UART_PROFILE_BEGIN(state, sample);
+
+    /* Clearing OERR resets the FIFO, so the five characters it holds are
+     * saved first. Reception is stopped until OERR is cleared. */
+    UART_RxDrain(port);
+
+    if(port->registers->sta & UART_STA_OERR)
+    {
+        state->statistics.overrunErrors++;
+        port->registers->sta &= ~UART_STA_OERR;
+    }
+
+    UART_PROFILE_END(state, sample);
+}
+
+/*********************************************************************
+* Function: UART_ProfileBegin(UART_PROFILE_SAMPLE *sample);
+*
+* Overview: Records the entry time of a profiled interrupt and the
+*           profiled time of all UARTs so far
+*
+* PreCondition: Called on entry to a UART interrupt
+*
+* Input: UART_PROFILE_SAMPLE *sample - entry record
+*
+* Output: none
+*
+********************************************************************/
+static void UART_ProfileBegin(UART_PROFILE_SAMPLE *sample)
+{
+    uint16_t ipl;
+
+    // uartProfileTicks is 32-bit and updated by higher priority handlers
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    sample->start = TIME_NowTicks();
+    sample->nested = uartProfileTicks;
+    RESTORE_CPU_IPL(ipl);
+}
+
+/*********************************************************************
+* Function: UART_ProfileEnd(UART_STATE *state,
+*                           const UART_PROFILE_SAMPLE *sample);
+*
+* Overview: Adds the time of a profiled interrupt, less that of the
+*           UART interrupts that preempted it, to isrTicks
+*
+* PreCondition: UART_ProfileBegin() on entry to the same interrupt
+*
+* Input: UART_STATE *state - UART being profiled
+*        const UART_PROFILE_SAMPLE *sample - entry record
+*
+* Output: none
+*
+********************************************************************/
+static void UART_ProfileEnd(UART_STATE *state, const UART_PROFILE_SAMPLE *sample)
+{
+    uint32_t ticks;
+    uint16_t ipl;
+
+    SET_AND_SAVE_CPU_IPL(ipl, 7);
+    ticks = (TIME_NowTicks() - sample->start) - (uartProfileTicks - sample->nested);
+    uartProfileTicks += ticks;
+    state->statistics.isrTicks += ticks;
+    RESTORE_CPU_IPL(ipl);
 }
 
 /*
- U1TX transfer completed interrupt
+ Interrupt vectors of UART n. The flags are cleared with a bit field
+ write (a single BCLR) because the hardware may set another flag in the
+ same IFSx register at any time; a masked read-modify-write could lose
+ it. txRxFlags and errorFlags are the IFSx register numbers.
  */
-//void __attribute__ ( ( __interrupt__ , auto_psv ) ) _U1TX1Interrupt(void)
-//{    
-//    IFS0bits.U1TXIF = 0; // The user should clear the UxTXIF bit in the ISR.   
-//}
+#define UART_INTERRUPT_HANDLERS(n, txRxFlags, errorFlags)                            \
+void __attribute__ ( ( __interrupt__ , auto_psv ) ) _U##n##TXInterrupt(void)         \
+{                                                                                    \
+    IFS##txRxFlags##bits.U##n##TXIF = 0;                                             \
+    UART_TxInterrupt(&uartPorts[UART_ID_##n]);                                       \
+}                                                                                    \
+                                                                                     \
+void __attribute__ ( ( __interrupt__ , auto_psv ) ) _U##n##RXInterrupt(void)         \
+{                                                                                    \
+    IFS##txRxFlags##bits.U##n##RXIF = 0;                                             \
+    UART_RxInterrupt(&uartPorts[UART_ID_##n]);                                       \
+}                                                                                    \
+                                                                                     \
+void __attribute__ ( ( __interrupt__ , auto_psv ) ) _U##n##ErrInterrupt(void)        \
+{                                                                                    \
+    IFS##errorFlags##bits.U##n##ERIF = 0;                                            \
+    UART_ErrorInterrupt(&uartPorts[UART_ID_##n]);                                    \
+}
+
+UART_INTERRUPT_HANDLERS(1, 0, 4)
+UART_INTERRUPT_HANDLERS(2, 1, 4)
+UART_INTERRUPT_HANDLERS(3, 5, 5)
+UART_INTERRUPT_HANDLERS(4, 5, 5)
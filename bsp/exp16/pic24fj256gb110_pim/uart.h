@@ -34,12 +34,70 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+/* UART1 bit rate after UART_Initialize() */
+#define UART_DEFAULT_BAUD   9600
+
+/* Multidrop address every node accepts */
+#define UART_MULTIDROP_BROADCAST    0xFF
+
+/* Hardware UARTs. UART1 is the console; the UART_Instance functions
+ * drive any of them, the others act on UART1. */
+typedef enum
+{
+    UART_ID_1 = 0,      // TX RF3, RX RF2, RTS RF13, CTS RF12
+    UART_ID_2,          // TX RF5, RX RF4
+    UART_ID_3,          // TX RD0, RX RD11
+    UART_ID_4,          // TX RD10, RX RD9
+    UART_COUNT
+} UART_ID;
+
+/* Parity settings, shared by UART1 and the bit bang UART */
+typedef enum
+{
+    UART_PARITY_NONE = 0,
+    UART_PARITY_ODD,
+    UART_PARITY_EVEN,
+    UART_PARITY_MARK,
+    UART_PARITY_SPACE
+} UART_PARITY;
+
+typedef struct
+{
+    uint32_t txBytes;           // bytes queued for transmission
+    uint32_t rxBytes;           // bytes read from the receiver
+    uint16_t rxDropped;         // received bytes lost to a full receive queue
+    uint16_t overrunErrors;     // hardware FIFO overruns (OERR)
+    uint16_t framingErrors;     // characters discarded for a framing error (FERR)
+    uint16_t parityErrors;      // characters discarded for a parity error (PERR)
+    uint32_t txInterrupts;
+    uint32_t rxInterrupts;
+    uint32_t isrTicks;          // TX, RX and error interrupt time while profiling
+    uint16_t addressFrames;     // multidrop frames addressed to this node
+} UART_STATISTICS;
+
+/*********************************************************************
+* Function: UART_PinsInitialize(void);
+*
+* Overview: Routes the pins of all four UARTs, including the UART1
+*           RTS/CTS pins, through the peripheral pin select
+*
+* PreCondition: PPS registers unlocked. The mapping locks for good at
+*               the first relock (IOL1WAY), so this is called from the
+*               one unlock window in SYS_Initialize().
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+void UART_PinsInitialize(void);
+
 /*********************************************************************
 * Function: UART_Initialize(void);
 *
-* Overview: Initializes UART
+* Overview: Initializes UART1 at UART_DEFAULT_BAUD
 *
-* PreCondition: none
+* PreCondition: UART_PinsInitialize()
 *
 * Input: none
 *
@@ -48,6 +106,124 @@
 ********************************************************************/
 void UART_Initialize(void);
 
+/*********************************************************************
+* Function: UART_InstanceInitialize(UART_ID id, uint32_t baud);
+*
+* Overview: Initializes one UART for 8-bit data, no parity, 1 stop bit
+*           with interrupt driven transmit and receive queues. Each UART
+*           has its own queues and UART_STATISTICS.
+*
+* PreCondition: UART_PinsInitialize()
+*
+* Input: UART_ID id - UART to initialize
+*        uint32_t baud - bit rate, see UART_SetBaud()
+*
+* Output: true if initialized, false for an unknown UART or a bit rate
+*         out of range
+*
+********************************************************************/
+bool UART_InstanceInitialize(UART_ID id, uint32_t baud);
+
+/*********************************************************************
+* Function: UART_InstancePutChar(UART_ID id, uint8_t data);
+*           UART_InstanceWrite(UART_ID id, const uint8_t *data,
+*                              uint16_t length);
+*           UART_InstanceGetChar(UART_ID id, uint8_t *data);
+*           UART_InstancePutWord(UART_ID id, uint16_t data);
+*           UART_InstanceGetWord(UART_ID id, uint16_t *data);
+*           UART_InstanceSetFormat(UART_ID id, uint8_t dataBits,
+*                                  UART_PARITY parity, uint8_t stopBits);
+*           UART_InstanceStatisticsGet(UART_ID id,
+*                                      UART_STATISTICS *statistics);
+*           UART_InstanceSetBaud(UART_ID id, uint32_t baud);
+*           UART_InstanceGetBaud(UART_ID id);
+*           UART_InstanceLoopbackEnable(UART_ID id, bool enable);
+*           UART_InstanceProfileEnable(UART_ID id, bool enable);
+*           UART_InstanceAutoBaudStart(UART_ID id);
+*           UART_InstanceAutoBaudComplete(UART_ID id);
+*
+* Overview: As the UART1 functions of the same name below, for the
+*           given UART. The Word functions move whole characters,
+*           including the 9th bit with 9 data bits; with 8 data bits
+*           they behave as the Char functions.
+*
+* PreCondition: UART_InstanceInitialize(id)
+*
+********************************************************************/
+void UART_InstancePutChar(UART_ID id, uint8_t data);
+void UART_InstanceWrite(UART_ID id, const uint8_t *data, uint16_t length);
+bool UART_InstanceGetChar(UART_ID id, uint8_t *data);
+void UART_InstancePutWord(UART_ID id, uint16_t data);
+bool UART_InstanceGetWord(UART_ID id, uint16_t *data);
+bool UART_InstanceSetFormat(UART_ID id, uint8_t dataBits, UART_PARITY parity, uint8_t stopBits);
+
+/*********************************************************************
+* Function: UART_InstanceMultidropEnable(UART_ID id, bool enable,
+*                                        uint8_t address);
+*
+* Overview: Switches 9-bit multidrop reception on or off. When on the
+*           UART uses 9 data bits and address detection (ADDEN): the
+*           hardware discards data characters, and so never interrupts,
+*           until an address character (9th bit set) for this node or
+*           UART_MULTIDROP_BROADCAST arrives. That address and the data
+*           that follows are queued, see UART_InstanceGetWord(); the
+*           next address for another node stops reception again.
+*           Switching off returns to 8 data bits, no parity. The stop
+*           bits are kept. While on, UART_InstanceSetFormat() is refused.
+*
+* PreCondition: UART_InstanceInitialize(id), not called from an
+*               interrupt
+*
+* Input: UART_ID id - UART to configure
+*        bool enable - true for multidrop
+*        uint8_t address - this node, 0 to 254
+*
+* Output: true if applied
+*
+********************************************************************/
+bool UART_InstanceMultidropEnable(UART_ID id, bool enable, uint8_t address);
+
+/*********************************************************************
+* Function: UART_InstanceSendAddress(UART_ID id, uint8_t address);
+*
+* Overview: Queues an address character, the start of a multidrop
+*           frame. Send the data with UART_InstancePutChar().
+*
+* PreCondition: 9 data bits, see UART_InstanceMultidropEnable()
+*
+* Input: UART_ID id - UART to send on
+*        uint8_t address - node, or UART_MULTIDROP_BROADCAST for all
+*
+* Output: none
+*
+********************************************************************/
+void UART_InstanceSendAddress(UART_ID id, uint8_t address);
+void UART_InstanceStatisticsGet(UART_ID id, UART_STATISTICS *statistics);
+uint32_t UART_InstanceSetBaud(UART_ID id, uint32_t baud);
+uint32_t UART_InstanceGetBaud(UART_ID id);
+void UART_InstanceLoopbackEnable(UART_ID id, bool enable);
+void UART_InstanceProfileEnable(UART_ID id, bool enable);
+void UART_InstanceAutoBaudStart(UART_ID id);
+bool UART_InstanceAutoBaudComplete(UART_ID id);
+
+/*********************************************************************
+* Function: UART_InstanceFlowControlEnable(UART_ID id, bool enable);
+*
+* Overview: As UART_FlowControlEnable(), for the given UART. Only UART1
+*           has RTS and CTS pins mapped.
+*
+* PreCondition: UART_InstanceInitialize(id), not called from an
+*               interrupt
+*
+* Input: UART_ID id - UART to configure
+*        bool enable - true for RTS/CTS, false for TX/RX only
+*
+* Output: false if flow control was requested on a UART without the
+*         pins for it
+*
+********************************************************************/
+bool UART_InstanceFlowControlEnable(UART_ID id, bool enable);
+
 /*********************************************************************
 * Function: UART_Transmit(void);
 *
@@ -61,5 +237,212 @@ void UART_Initialize(void);
 *
 ********************************************************************/
 void UART_Transmit(void);
+
+/*********************************************************************
+* Function: UART_PutChar(uint8_t data);
+*
+* Overview: Queues one byte for interrupt driven transmission, waiting
+*           for room in the transmit queue. Safe to call from interrupts;
+*           above the TX interrupt priority a full queue is drained by
+*           polling.
+*
+* PreCondition: UART_Initialize()
+*
+* Input: uint8_t data - byte to send
+*
+* Output: none
+*
+********************************************************************/
+void UART_PutChar(uint8_t data);
+
+/*********************************************************************
+* Function: UART_Write(const uint8_t *data, uint16_t length);
+*
+* Overview: Queues a block of bytes for transmission, waiting for room
+*           in the transmit queue as required
+*
+* PreCondition: UART_Initialize()
+*
+* Input: const uint8_t *data - bytes to send
+*        uint16_t length - number of bytes
+*
+* Output: none
+*
+********************************************************************/
+void UART_Write(const uint8_t *data, uint16_t length);
+
+/*********************************************************************
+* Function: UART_GetChar(uint8_t *data);
+*
+* Overview: Takes the oldest byte from the interrupt driven receive
+*           queue. Does not block.
+*
+* PreCondition: UART_Initialize()
+*
+* Input: uint8_t *data - where to store the byte
+*
+* Output: true if a byte was returned, false if nothing was received
+*
+********************************************************************/
+bool UART_GetChar(uint8_t *data);
+
+/*********************************************************************
+* Function: UART_StatisticsGet(UART_STATISTICS *statistics);
+*
+* Overview: Copies the transfer and error counters
+*
+* PreCondition: UART_Initialize()
+*
+* Input: UART_STATISTICS *statistics - where to copy the counters
+*
+* Output: none
+*
+********************************************************************/
+void UART_StatisticsGet(UART_STATISTICS *statistics);
+
+/*********************************************************************
+* Function: UART_SetBaud(uint32_t baud);
+*
+* Overview: Sets the bit rate, choosing BRGH and U1BRG for the smallest
+*           error from FCY. Waits until queued data has been sent so
+*           nothing is garbled by the switch. At 4 MHz FCY the error is
+*           0.2% up to 38400, 2.1% at 57600 and 3.5% at 115200; compare
+*           the returned rate with the request to judge the result.
+*
+* PreCondition: UART_Initialize(), not called from an interrupt
+*
+* Input: uint32_t baud - requested bit rate
+*
+* Output: uint32_t - bit rate actually set, 0 if out of range (the
+*         setting is then unchanged)
+*
+********************************************************************/
+uint32_t UART_SetBaud(uint32_t baud);
+
+/*********************************************************************
+* Function: UART_SetFormat(uint8_t dataBits, UART_PARITY parity,
+*                          uint8_t stopBits);
+*
+* Overview: Sets the UART1 frame format in hardware (PDSEL, STSEL):
+*           8 data bits with no, odd or even parity, or 9 data bits
+*           without parity, and 1 or 2 stop bits. Mark and space
+*           parity are sent as 9-bit frames with the 9th bit fixed at 1
+*           or 0; a received character with the wrong 9th bit counts as
+*           a parity error. Other formats (fewer than 8 or more than 9
+*           data bits, 0 stop bits) are left to the bit bang UART.
+*           Waits until queued data has been sent; the module is
+*           briefly disabled.
+*
+* PreCondition: UART_Initialize(), not called from an interrupt
+*
+* Input: uint8_t dataBits - 8 or 9
+*        UART_PARITY parity - parity setting
+*        uint8_t stopBits - 1 or 2
+*
+* Output: true if applied, false if the hardware cannot send the format
+*         or multidrop is on (the setting is then unchanged)
+*
+********************************************************************/
+bool UART_SetFormat(uint8_t dataBits, UART_PARITY parity, uint8_t stopBits);
+
+/*********************************************************************
+* Function: UART_FlowControlEnable(bool enable);
+*
+* Overview: Switches RTS/CTS hardware flow control on or off. U1RTS is
+*           on RF13 and U1CTS on RF12 (both active low). When enabled
+*           the transmitter waits for CTS, and RTS is released when the
+*           receive FIFO is full or the receive queue passes its high
+*           watermark, so a slow application never overruns.
+*           Waits for queued data to be sent; the module is briefly
+*           disabled to change UEN.
+*
+* PreCondition: UART_Initialize(), not called from an interrupt
+*
+* Input: bool enable - true for RTS/CTS, false for TX/RX only
+*
+* Output: none
+*
+********************************************************************/
+void UART_FlowControlEnable(bool enable);
+
+/*********************************************************************
+* Function: UART_LoopbackEnable(bool enable);
+*
+* Overview: Switches internal loopback (LPBACK) on or off. Transmitted
+*           data is received back without reaching the pins. Waits for
+*           queued data to be sent first.
+*
+* PreCondition: UART_Initialize(), not called from an interrupt
+*
+* Input: bool enable - true for loopback
+*
+* Output: none
+*
+********************************************************************/
+void UART_LoopbackEnable(bool enable);
+
+/*********************************************************************
+* Function: UART_ProfileEnable(bool enable);
+*
+* Overview: Starts or stops accumulating the time spent in the UART
+*           interrupts into UART_STATISTICS.isrTicks (TIME_NowTicks()
+*           ticks). Adds two timestamp reads to each interrupt while on.
+*           Time in a profiled UART interrupt that preempted another is
+*           only counted once.
+*
+* PreCondition: UART_Initialize(), TIME_Initialize()
+*
+* Input: bool enable - true to measure
+*
+* Output: none
+*
+********************************************************************/
+void UART_ProfileEnable(bool enable);
+
+/*********************************************************************
+* Function: UART_GetBaud(void);
+*
+* Overview: Returns the current bit rate, including one measured by
+*           auto-baud detection
+*
+* PreCondition: UART_Initialize()
+*
+* Input: none
+*
+* Output: uint32_t - bit rate
+*
+********************************************************************/
+uint32_t UART_GetBaud(void);
+
+/*********************************************************************
+* Function: UART_AutoBaudStart(void);
+*
+* Overview: Waits until queued data has been sent, then arms auto-baud
+*           detection (ABAUD). The next character received must be 'U'
+*           (0x55); its edges are timed and U1BRG is loaded from the
+*           measurement. The sync character is not stored.
+*
+* PreCondition: UART_Initialize(), not called from an interrupt
+*
+* Input: none
+*
+* Output: none
+*
+********************************************************************/
+void UART_AutoBaudStart(void);
+
+/*********************************************************************
+* Function: UART_AutoBaudComplete(void);
+*
+* Overview: Reports whether auto-baud detection has finished
+*
+* PreCondition: UART_AutoBaudStart()
+*
+* Input: none
+*
+* Output: true once the rate has been measured, see UART_GetBaud()
+*
+********************************************************************/
+bool UART_AutoBaudComplete(void);
 #endif	/* UART_H */
 
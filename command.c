@@ -0,0 +1,654 @@
+/*******************************************************************************
+ Explorer 16 Demo Command Interpreter File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    command.c
+
+  Summary:
+    Serial command interpreter for the Explorer 16 Demo
+
+  Description:
+    Line based command interpreter on UART1. Each line is a command name
+    followed by an optional argument, for example "parity odd" or
+    "baud 4800". Settings take effect on the next bit bang frame.
+ *******************************************************************************/
+
+// DOM-IGNORE-BEGIN
+/*******************************************************************************
+Copyright (c) 2013 released Microchip Technology Inc.  All rights reserved.
+
+Microchip licenses to you the right to use, modify, copy and distribute
+Software only when embedded on a Microchip microcontroller or digital signal
+controller that is integrated into your product or third party product
+(pursuant to the sublicense terms in the accompanying license agreement).
+
+You should refer to the license agreement accompanying this Software for
+additional information regarding your rights and obligations.
+
+SOFTWARE AND DOCUMENTATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY WARRANTY OF
+MERCHANTABILITY, TITLE, NON-INFRINGEMENT AND FITNESS FOR A PARTICULAR PURPOSE.
+IN NO EVENT SHALL MICROCHIP OR ITS LICENSORS BE LIABLE OR OBLIGATED UNDER
+CONTRACT, NEGLIGENCE, STRICT LIABILITY, CONTRIBUTION, BREACH OF WARRANTY, OR
+OTHER LEGAL EQUITABLE THEORY ANY DIRECT OR INDIRECT DAMAGES OR EXPENSES
+INCLUDING BUT NOT LIMITED TO ANY INCIDENTAL, SPECIAL, INDIRECT, PUNITIVE OR
+CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, COST OF PROCUREMENT OF
+SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
+(INCLUDING BUT NOT LIMITED TO ANY DEFENSE THEREOF), OR OTHER SIMILAR COSTS.
+ *******************************************************************************/
+// DOM-IGNORE-END
+
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <string.h>
+#include <stddef.h>
+#include <system.h>
+
+#include "app.h"
+#include "command.h"
+#include "benchmark.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: File Scope Variables and Functions
+// *****************************************************************************
+// *****************************************************************************
+
+typedef struct
+{
+    const char *name;
+    void (*handler)(const char *argument);
+    const char *help;
+} COMMAND_ENTRY;
+
+static void COMMAND_Execute(char *line);
+static bool COMMAND_ParseNumber(const char *text, uint32_t *value);
+static const char *COMMAND_ParseField(const char *text, uint32_t *value);
+static void COMMAND_Result(bool success);
+static void COMMAND_Help(const char *argument);
+static void COMMAND_Bits(const char *argument);
+static void COMMAND_Parity(const char *argument);
+static void COMMAND_Stop(const char *argument);
+static void COMMAND_Baud(const char *argument);
+static void COMMAND_Payload(const char *argument);
+static void COMMAND_Send(const char *argument);
+static void COMMAND_Address(const char *argument);
+static void COMMAND_Multidrop(const char *argument);
+static void COMMAND_UartBaud(const char *argument);
+static void COMMAND_AutoBaud(const char *argument);
+static void COMMAND_Flow(const char *argument);
+static void COMMAND_Bench(const char *argument);
+static void COMMAND_Stats(const char *argument);
+static void COMMAND_Trace(const char *argument);
+static void COMMAND_Stack(const char *argument);
+static void COMMAND_Spi(const char *argument);
+static void COMMAND_Eeprom(const char *argument);
+
+/* Command table and text are const, so they stay in program memory */
+static const COMMAND_ENTRY commandTable[] =
+{
+    { "help",     COMMAND_Help,      "list commands" },
+    { "bits",     COMMAND_Bits,      "<8..64> bit bang data bits, multiple of 8" },
+    { "parity",   COMMAND_Parity,    "<none|odd|even|mark|space> bit bang parity" },
+    { "stop",     COMMAND_Stop,      "<0..2> bit bang stop bits" },
+    { "baud",     COMMAND_Baud,      "<300..19200> bit bang bit rate" },
+    { "payload",  COMMAND_Payload,   "<text> bit bang frame bytes, sets the data bits" },
+    { "send",     COMMAND_Send,      "send one frame, on uart2 if 8 data bits" },
+    { "address",  COMMAND_Address,   "<on|off> bit bang 9-bit frames, first byte is the address" },
+    { "mdrop",    COMMAND_Multidrop, "<off|0..254> uart2 9-bit multidrop node address" },
+    { "ubaud",    COMMAND_UartBaud,  "<rate> console (UART1) bit rate" },
+    { "autobaud", COMMAND_AutoBaud,  "detect the console bit rate from a 'U'" },
+    { "flow",     COMMAND_Flow,      "<on|off> console RTS/CTS flow control" },
+    { "bench",    COMMAND_Bench,     "[bytes] console UART loopback benchmark" },
+    { "stats",    COMMAND_Stats,     "show settings and counters" },
+    { "trace",    COMMAND_Trace,     "[clear] dump the binary event trace" },
+    { "stack",    COMMAND_Stack,     "show stack usage" },
+    { "spi",      COMMAND_Spi,       "send the next SPI1 demo message (SS on RG9)" },
+    { "eeprom",   COMMAND_Eeprom,    "[read <addr> [n]|write <addr> <text>|flush] 25LC256" },
+};
+
+#define COMMAND_COUNT   (sizeof(commandTable) / sizeof(commandTable[0]))
+
+static const char * const commandParityNames[] =
+{
+    "none", "odd", "even", "mark", "space"
+};
+
+static const char commandPrompt[] = "> ";
+
+/* Most bytes shown by one "eeprom read" */
+#define COMMAND_EEPROM_READ_MAX 16
+
+/* Frames the hardware UART can produce are sent on UART2 (RF5), the rest
+   fall back to the bit bang UART on RA0 */
+#define COMMAND_FRAME_UART      UART_ID_2
+
+static char commandLine[COMMAND_LINE_LENGTH + 1];
+static uint8_t commandLength;
+static bool commandLastWasReturn;
+static bool commandAutoBaudPending;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+/*******************************************************************************
+
+  Function:
+   void COMMAND_Initialize( void )
+
+  Summary:
+    Prints the banner and the first prompt
+
+ */
+void COMMAND_Initialize(void)
+{
+    PRINT_CONFIGURATION previous = PRINT_GetConfiguration();
+
+    commandLength = 0;
+    commandLastWasReturn = false;
+
+    UART_InstanceInitialize(COMMAND_FRAME_UART, UART_DEFAULT_BAUD);
+
+    PRINT_SetConfiguration(PRINT_CONFIGURATION_UART);
+    PRINT_Formatted("\r\nExplorer 16 bit bang UART, type help\r\n%s", commandPrompt);
+    PRINT_SetConfiguration(previous);
+}
+
+/*******************************************************************************
+
+  Function:
+   void COMMAND_Tasks( void )
+
+  Summary:
+    Processes received characters
+
+ */
+void COMMAND_Tasks(void)
+{
+    PRINT_CONFIGURATION previous;
+    uint8_t received;
+
+    if(commandAutoBaudPending && UART_AutoBaudComplete())
+    {
+        commandAutoBaudPending = false;
+
+        previous = PRINT_GetConfiguration();
+        PRINT_SetConfiguration(PRINT_CONFIGURATION_UART);
+        PRINT_Formatted("\r\nuart1 locked at %lu baud\r\n%s", UART_GetBaud(), commandPrompt);
+        PRINT_SetConfiguration(previous);
+    }
+
+    if(!UART_GetChar(&received))
+    {
+        return;
+    }
+
+    previous = PRINT_GetConfiguration();
+    PRINT_SetConfiguration(PRINT_CONFIGURATION_UART);
+
+    do
+    {
+        switch(received)
+        {
+            case '\n':
+                if(commandLastWasReturn)
+                {
+                    // second half of a CR LF pair
+                    commandLastWasReturn = false;
+                    break;
+                }
+                // fall through
+            case '\r':
+                commandLastWasReturn = (received == '\r');
+                PRINT_Formatted("\r\n");
+                commandLine[commandLength] = 0;
+                COMMAND_Execute(commandLine);
+                commandLength = 0;
+                PRINT_Formatted("%s", commandPrompt);
+                break;
+
+            case '\b':
+            case 0x7F:
+                commandLastWasReturn = false;
+                if(commandLength != 0)
+                {
+                    commandLength--;
+                    PRINT_Formatted("\b \b");
+                }
+                break;
+
+            default:
+                commandLastWasReturn = false;
+                if((received >= ' ') && (commandLength < COMMAND_LINE_LENGTH))
+                {
+                    commandLine[commandLength++] = (char)received;
+                    PRINT_Char((char)received);
+                }
+                break;
+        }
+    } while(UART_GetChar(&received));
+
+    PRINT_SetConfiguration(previous);
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Local Functions
+// *****************************************************************************
+// *****************************************************************************
+
+/*******************************************************************************
+
+  Function:
+   static void COMMAND_Execute( char *line )
+
+  Summary:
+    Splits a line into command name and argument and runs the command
+
+ */
+static void COMMAND_Execute(char *line)
+{
+    char *argument;
+    uint8_t i;
+
+    while(*line == ' ')
+    {
+        line++;
+    }
+
+    if(*line == 0)
+    {
+        return;
+    }
+
+    argument = line;
+    while((*argument != 0) && (*argument != ' '))
+    {
+        argument++;
+    }
+    if(*argument != 0)
+    {
+        *argument++ = 0;
+        while(*argument == ' ')
+        {
+            argument++;
+        }
+    }
+
+    for(i = 0; i < COMMAND_COUNT; i++)
+    {
+        if(strcmp(line, commandTable[i].name) == 0)
+        {
+            commandTable[i].handler(argument);
+            return;
+        }
+    }
+
+    PRINT_Formatted("unknown command '%s'\r\n", line);
+}
+
+/*******************************************************************************
+
+  Function:
+   static bool COMMAND_ParseNumber( const char *text, uint32_t *value )
+
+  Summary:
+    Parses an unsigned decimal number that makes up the whole of text
+
+ */
+static bool COMMAND_ParseNumber(const char *text, uint32_t *value)
+{
+    text = COMMAND_ParseField(text, value);
+
+    return ((text != NULL) && (*text == 0));
+}
+
+/*******************************************************************************
+
+  Function:
+   static const char *COMMAND_ParseField( const char *text, uint32_t *value )
+
+  Summary:
+    Parses an unsigned decimal number ending at a space or the end of text
+
+  Returns:
+    The text after the number and the spaces following it, NULL if text
+    does not start with a number
+
+ */
+static const char *COMMAND_ParseField(const char *text, uint32_t *value)
+{
+    const char *start = text;
+    uint32_t result = 0;
+
+    while((*text != 0) && (*text != ' '))
+    {
+        if((*text < '0') || (*text > '9') || (result > 99999999UL))
+        {
+            return NULL;
+        }
+        result = (result * 10) + (*text++ - '0');
+    }
+
+    if(text == start)
+    {
+        return NULL;
+    }
+
+    while(*text == ' ')
+    {
+        text++;
+    }
+
+    *value = result;
+    return text;
+}
+
+/*******************************************************************************
+
+  Function:
+   static void COMMAND_Result( bool success )
+
+  Summary:
+    Reports whether a setting was applied
+
+ */
+static void COMMAND_Result(bool success)
+{
+    if(success)
+    {
+        PRINT_Formatted("ok\r\n");
+    }
+    else
+    {
+        PRINT_Formatted("rejected (invalid value or frame in progress)\r\n");
+    }
+}
+
+/* Command handlers. argument is the rest of the line after the command name,
+   an empty string if there is none. */
+
+static void COMMAND_Help(const char *argument)
+{
+    uint8_t i;
+
+    for(i = 0; i < COMMAND_COUNT; i++)
+    {
+        PRINT_Formatted("%8s %s\r\n", commandTable[i].name, commandTable[i].help);
+    }
+}
+
+static void COMMAND_Bits(const char *argument)
+{
+    uint32_t value;
+
+    COMMAND_Result(COMMAND_ParseNumber(argument, &value) && (value <= 0xFF) &&
+                   UART_SIM_SetDataBits((uint8_t)value));
+}
+
+static void COMMAND_Parity(const char *argument)
+{
+    uint8_t i;
+
+    for(i = 0; i < (sizeof(commandParityNames) / sizeof(commandParityNames[0])); i++)
+    {
+        if(strcmp(argument, commandParityNames[i]) == 0)
+        {
+            COMMAND_Result(UART_SIM_SetParity((UART_PARITY)i));
+            return;
+        }
+    }
+
+    COMMAND_Result(false);
+}
+
+static void COMMAND_Stop(const char *argument)
+{
+    uint32_t value;
+
+    COMMAND_Result(COMMAND_ParseNumber(argument, &value) && (value <= 2) &&
+                   UART_SIM_SetStopBits((uint8_t)value));
+}
+
+static void COMMAND_Baud(const char *argument)
+{
+    uint32_t value;
+
+    COMMAND_Result(COMMAND_ParseNumber(argument, &value) && UART_SIM_SetBaud(value));
+}
+
+static void COMMAND_Payload(const char *argument)
+{
+    COMMAND_Result(UART_SIM_SetPayload(argument));
+}
+
+static void COMMAND_Send(const char *argument)
+{
+    UART_SIM_CONFIGURATION simulation;
+
+    UART_SIM_GetConfiguration(&simulation);
+
+    /* 8N/E/O/M/S with 1 or 2 stop bits is done by the silicon, unless
+     * mdrop holds UART2 in multidrop; the format is then refused and the
+     * frame goes out on the bit bang UART instead */
+    if((simulation.dataBits == 8) && !simulation.addressMode &&
+       UART_InstanceSetFormat(COMMAND_FRAME_UART, 8, simulation.parity, simulation.stopBits) &&
+       (UART_InstanceSetBaud(COMMAND_FRAME_UART, simulation.baud) != 0))
+    {
+        UART_InstancePutChar(COMMAND_FRAME_UART, (uint8_t)simulation.payload[0]);
+        PRINT_Formatted("sent on uart2\r\n");
+        return;
+    }
+
+    COMMAND_Result(UART_SIM_Send());
+}
+
+static void COMMAND_Address(const char *argument)
+{
+    if(strcmp(argument, "on") == 0)
+    {
+        COMMAND_Result(UART_SIM_SetAddressMode(true));
+    }
+    else if(strcmp(argument, "off") == 0)
+    {
+        COMMAND_Result(UART_SIM_SetAddressMode(false));
+    }
+    else
+    {
+        COMMAND_Result(false);
+    }
+}
+
+static void COMMAND_Multidrop(const char *argument)
+{
+    uint32_t value;
+
+    if(strcmp(argument, "off") == 0)
+    {
+        COMMAND_Result(UART_InstanceMultidropEnable(COMMAND_FRAME_UART, false, 0));
+        return;
+    }
+
+    COMMAND_Result(COMMAND_ParseNumber(argument, &value) && (value < UART_MULTIDROP_BROADCAST) &&
+                   UART_InstanceMultidropEnable(COMMAND_FRAME_UART, true, (uint8_t)value));
+}
+
+static void COMMAND_UartBaud(const char *argument)
+{
+    uint32_t value;
+    uint32_t actual;
+    uint32_t error;
+
+    if(!COMMAND_ParseNumber(argument, &value) || (value == 0))
+    {
+        COMMAND_Result(false);
+        return;
+    }
+
+    // sent at the old rate, UART_SetBaud() waits for it to drain
+    PRINT_Formatted("switching to %lu baud\r\n", value);
+
+    actual = UART_SetBaud(value);
+    if(actual == 0)
+    {
+        COMMAND_Result(false);
+        return;
+    }
+
+    error = (((actual > value) ? (actual - value) : (value - actual)) * 1000) / value;
+    PRINT_Formatted("uart1 %lu baud, error %.1lu%%\r\n", actual, error);
+}
+
+static void COMMAND_AutoBaud(const char *argument)
+{
+    PRINT_Formatted("send 'U' at the new rate\r\n");
+
+    UART_AutoBaudStart();
+    commandAutoBaudPending = true;
+}
+
+static void COMMAND_Flow(const char *argument)
+{
+    if(strcmp(argument, "on") == 0)
+    {
+        UART_FlowControlEnable(true);
+    }
+    else if(strcmp(argument, "off") == 0)
+    {
+        UART_FlowControlEnable(false);
+    }
+    else
+    {
+        COMMAND_Result(false);
+        return;
+    }
+
+    COMMAND_Result(true);
+}
+
+static void COMMAND_Bench(const char *argument)
+{
+    uint32_t value = BENCH_DEFAULT_PAYLOAD;
+
+    if((*argument != 0) && !COMMAND_ParseNumber(argument, &value))
+    {
+        COMMAND_Result(false);
+        return;
+    }
+
+    COMMAND_Result((value <= BENCH_MAX_PAYLOAD) && BENCH_Run((uint16_t)value));
+}
+
+static void COMMAND_Stats(const char *argument)
+{
+    UART_SIM_CONFIGURATION simulation;
+    UART_STATISTICS uart;
+
+    UART_SIM_GetConfiguration(&simulation);
+    UART_StatisticsGet(&uart);
+
+    PRINT_Formatted("bit bang: %u data, parity %s, %u stop, %lu baud, payload \"",
+                    simulation.dataBits, commandParityNames[simulation.parity],
+                    simulation.stopBits, simulation.baud);
+    PRINT_String(simulation.payload, simulation.dataBits / 8);
+    PRINT_Formatted("\"\r\n          %u frames sent%s%s\r\n",
+                    simulation.framesSent, simulation.busy ? ", sending" : "",
+                    simulation.addressMode ? ", 9-bit address mode" : "");
+    PRINT_Formatted("uart1:    %lu baud, tx %lu rx %lu dropped %u\r\n",
+                    UART_GetBaud(), uart.txBytes, uart.rxBytes, uart.rxDropped);
+    PRINT_Formatted("          overrun %u framing %u parity %u\r\n",
+                    uart.overrunErrors, uart.framingErrors, uart.parityErrors);
+
+    UART_InstanceStatisticsGet(COMMAND_FRAME_UART, &uart);
+    PRINT_Formatted("uart2:    %lu baud, tx %lu rx %lu rx interrupts %lu\r\n",
+                    UART_InstanceGetBaud(COMMAND_FRAME_UART), uart.txBytes, uart.rxBytes, uart.rxInterrupts);
+    PRINT_Formatted("          addressed frames %u parity %u\r\n",
+                    uart.addressFrames, uart.parityErrors);
+    PRINT_Formatted("adc:      %u batches dropped\r\n", ADC_BatchOverrunGet());
+}
+
+static void COMMAND_Trace(const char *argument)
+{
+    if(strcmp(argument, "clear") == 0)
+    {
+        TRACE_Clear();
+        COMMAND_Result(true);
+        return;
+    }
+
+    TRACE_Dump();
+    PRINT_Formatted("\r\n");
+}
+
+static void COMMAND_Stack(const char *argument)
+{
+    PRINT_Formatted("stack: %u of %u bytes used\r\n", SYS_StackHighWaterGet(), SYS_StackSizeGet());
+}
+
+static void COMMAND_Spi(const char *argument)
+{
+    COMMAND_Result(SPI_Transmit());
+}
+
+static void COMMAND_Eeprom(const char *argument)
+{
+    EEPROM_STATISTICS statistics;
+    uint8_t data[COMMAND_EEPROM_READ_MAX];
+    const char *text;
+    uint32_t address;
+    uint32_t length = 1;
+    uint8_t i;
+
+    if(strncmp(argument, "read ", 5) == 0)
+    {
+        text = COMMAND_ParseField(argument + 5, &address);
+        if((text == NULL) || ((*text != 0) && !COMMAND_ParseNumber(text, &length)) ||
+           (length == 0) || (length > COMMAND_EEPROM_READ_MAX) || (address >= EEPROM_SIZE) ||
+           !EEPROM_Read((uint16_t)address, data, (uint16_t)length))
+        {
+            COMMAND_Result(false);
+            return;
+        }
+
+        PRINT_Formatted("%04x:", (uint16_t)address);
+        for(i = 0; i < length; i++)
+        {
+            PRINT_Formatted(" %02x", data[i]);
+        }
+        PRINT_Formatted("\r\n");
+    }
+    else if(strncmp(argument, "write ", 6) == 0)
+    {
+        // the rest of the line is written as text, without a terminator
+        text = COMMAND_ParseField(argument + 6, &address);
+        COMMAND_Result((text != NULL) && (*text != 0) && (address < EEPROM_SIZE) &&
+                       EEPROM_Write((uint16_t)address, text, strlen(text)));
+    }
+    else if(strcmp(argument, "flush") == 0)
+    {
+        COMMAND_Result(EEPROM_Flush());
+    }
+    else if(*argument == 0)
+    {
+        EEPROM_StatisticsGet(&statistics);
+        PRINT_Formatted("eeprom:   read hits %u misses %u, page fills %u writes %u, status polls %u%s\r\n",
+                        statistics.readHits, statistics.readMisses, statistics.pageFills,
+                        statistics.pageWrites, statistics.statusPolls,
+                        EEPROM_IsBusy() ? ", busy" : "");
+    }
+    else
+    {
+        COMMAND_Result(false);
+    }
+}
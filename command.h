@@ -0,0 +1,104 @@
+/*******************************************************************************
+ Explorer 16 Demo Command Interpreter Header File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    command.h
+
+  Summary:
+    Serial command interpreter for the Explorer 16 Demo
+
+  Description:
+    Reads lines from the UART1 receive queue and applies them to the bit
+    bang UART configuration. Type "help" for the command list.
+ *******************************************************************************/
+
+// DOM-IGNORE-BEGIN
+/*******************************************************************************
+Copyright (c) 2013 released Microchip Technology Inc.  All rights reserved.
+
+Microchip licenses to you the right to use, modify, copy and distribute
+Software only when embedded on a Microchip microcontroller or digital signal
+controller that is integrated into your product or third party product
+(pursuant to the sublicense terms in the accompanying license agreement).
+
+You should refer to the license agreement accompanying this Software for
+additional information regarding your rights and obligations.
+
+SOFTWARE AND DOCUMENTATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY WARRANTY OF
+MERCHANTABILITY, TITLE, NON-INFRINGEMENT AND FITNESS FOR A PARTICULAR PURPOSE.
+IN NO EVENT SHALL MICROCHIP OR ITS LICENSORS BE LIABLE OR OBLIGATED UNDER
+CONTRACT, NEGLIGENCE, STRICT LIABILITY, CONTRIBUTION, BREACH OF WARRANTY, OR
+OTHER LEGAL EQUITABLE THEORY ANY DIRECT OR INDIRECT DAMAGES OR EXPENSES
+INCLUDING BUT NOT LIMITED TO ANY INCIDENTAL, SPECIAL, INDIRECT, PUNITIVE OR
+CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, COST OF PROCUREMENT OF
+SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
+(INCLUDING BUT NOT LIMITED TO ANY DEFENSE THEREOF), OR OTHER SIMILAR COSTS.
+ *******************************************************************************/
+// DOM-IGNORE-END
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Constants
+// *****************************************************************************
+// *****************************************************************************
+
+/* Longest command line accepted, excluding the terminator */
+#define COMMAND_LINE_LENGTH     40
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+/*******************************************************************************
+
+  Function:
+   void COMMAND_Initialize( void )
+
+  Summary:
+    Prints the banner and the first prompt
+
+  Precondition:
+    UART_Initialize() has been called.
+
+ */
+void COMMAND_Initialize(void);
+
+/*******************************************************************************
+
+  Function:
+   void COMMAND_Tasks( void )
+
+  Summary:
+    Processes received characters
+
+  Description:
+    Echoes received characters, handles backspace and runs the command when
+    a carriage return or line feed arrives. Never blocks waiting for input;
+    call it from the main loop. Replies are sent through the print engine
+    on the UART sink, the previous sink is restored afterwards.
+
+  Precondition:
+    COMMAND_Initialize() has been called.
+
+ */
+void COMMAND_Tasks(void);
+
+#endif // COMMAND_H
@@ -54,10 +54,9 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include <stdbool.h>
 
 #include "app.h"
+#include "command.h"
+#include "system.h"
 
-#define ONE_VOLT 310
-#define ONE_TENTH_VOLT 31
-#define ONE_HUNDREDTH_VOLT 3
 
 // *****************************************************************************
 // *****************************************************************************
@@ -67,7 +66,17 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 
 void Respond_To_Button_Presses(void);
 void SYS_Initialize(void);
+static void APP_AdcTasks(void);
+static void APP_DisplayTasks(void);
 
+/* Constant display text.  const data is placed in the auto_psv section and
+   read straight from program memory, so none of it is copied into RAM */
+static const char appTimeLabel[] = "Time    ";
+
+#define APP_LCD_COLUMNS 16
+
+/* Redraw only when the reading moves by more than the ADC noise */
+#define APP_ADC_HYSTERESIS 2
 
 APP_DATA appData;
 bool _previous_button_s6_pressed_state = false;
@@ -83,16 +92,25 @@ bool _previous_button_s4_pressed_state = false;
 
 int main(void) 
 {
-    /* Call the System Initialize routine */
+    /* Call the System Initialize routine; it also starts the bit bang
+     * timer and the background LCD initialization */
     SYS_Initialize();
 
-    /*Initialize bit bang timer*/
-    TIMER_SetConfiguration();
+    /* Print to UART1 until APP_DisplayTasks() finds the LCD ready, so
+     * nothing waits for the LCD */
+    PRINT_SetConfiguration(PRINT_CONFIGURATION_UART);
+    appData.flags.rtc_lcd_update = 1;
+
+    /* Serial console on UART1 */
+    COMMAND_Initialize();
 
     /* Infinite Loop */
     while (1) 
     {
         Respond_To_Button_Presses();
+        COMMAND_Tasks();
+        APP_AdcTasks();
+        APP_DisplayTasks();
     };
 }
 
@@ -127,7 +145,7 @@ void Respond_To_Button_Presses(void)
     if(!_previous_button_s6_pressed_state && button_s6_pressed)
     {
         // trigger uart bit bang messaging
-        service_uart_emulation = true;
+        UART_SIM_Send();
     }
     
     bool button_s3_pressed = BUTTON_IsPressed(BUTTON_S3);
@@ -156,3 +174,170 @@ void Respond_To_Button_Presses(void)
     _previous_button_s5_pressed_state = button_s5_pressed;    
     _previous_button_s4_pressed_state = button_s4_pressed;
 }
+
+/*******************************************************************************
+
+  Function:
+   static void APP_AdcTasks( void )
+
+  Summary:
+    Consumes ADC batches and updates the displayed reading
+
+  Description:
+    Drains the ADC batch queue and averages the potentiometer samples of the
+    newest batch. The display is flagged for a redraw only when the value
+    moves by more than APP_ADC_HYSTERESIS counts.
+
+  Precondition:
+    ADC_Initialize() has been called.
+
+  Parameters:
+    None.
+
+  Returns:
+    None.
+
+  Remarks:
+
+ */
+
+/******************************************************************************/
+static void APP_AdcTasks(void)
+{
+    ADC_BATCH batch;
+    bool received = false;
+    uint16_t sum[ADC_SCAN_CHANNELS] = {0, 0};
+    uint16_t counts;
+    uint8_t channel;
+    uint8_t i;
+
+    while(ADC_BatchGet(&batch))
+    {
+        received = true;
+    }
+
+    if(!received)
+    {
+        return;
+    }
+
+    for(channel = 0; channel < ADC_SCAN_CHANNELS; channel++)
+    {
+        for(i = 0; i < ADC_SAMPLES_PER_CHANNEL; i++)
+        {
+            sum[channel] += batch.sample[channel][i];
+        }
+    }
+
+    counts = sum[ADC_SCAN_INDEX(ADC_CHANNEL_POTENTIOMETER)] / ADC_SAMPLES_PER_CHANNEL;
+    if((counts > appData.adcCounts + APP_ADC_HYSTERESIS) ||
+       (counts + APP_ADC_HYSTERESIS < appData.adcCounts))
+    {
+        appData.adcCounts = counts;
+        appData.flags.adc_lcd_update = 1;
+    }
+
+    counts = sum[ADC_SCAN_INDEX(ADC_CHANNEL_TEMPERATURE)] / ADC_SAMPLES_PER_CHANNEL;
+    if((counts > appData.temperatureCounts + APP_ADC_HYSTERESIS) ||
+       (counts + APP_ADC_HYSTERESIS < appData.temperatureCounts))
+    {
+        appData.temperatureCounts = counts;
+        appData.flags.adc_lcd_update = 1;
+    }
+}
+
+/*******************************************************************************
+
+  Function:
+   static void APP_DisplayTasks( void )
+
+  Summary:
+    Redraws the LCD when the time or the ADC reading has changed
+
+  Description:
+    The text is built on demand in a stack buffer from the RTCC time and the
+    binary ADC values, so no display strings are kept in RAM between updates.
+    Both rows are always written in full; after the 32nd character the LCD
+    driver wraps the cursor back to the home position, so no clear (and no
+    flicker) is needed between redraws.
+
+  Precondition:
+    LCD_InitializeStart() has been called. Nothing is drawn until the LCD
+    reports ready; the LCD is then selected as the print sink and the boot
+    time to that point is reported.
+
+  Parameters:
+    None.
+
+  Returns:
+    None.
+
+  Remarks:
+
+ */
+
+/******************************************************************************/
+static void APP_DisplayTasks(void)
+{
+    BSP_RTCC_DATETIME time;
+    char line[APP_LCD_COLUMNS];
+    int16_t temperature;
+    uint8_t i;
+
+    if(!appData.flags.lcd_ready)
+    {
+        if(!LCD_IsReady())
+        {
+            return;
+        }
+
+        appData.flags.lcd_ready = 1;
+        PRINT_SetConfiguration(PRINT_CONFIGURATION_LCD);
+        SYS_BootReport("lcd");
+    }
+
+    if(appData.flags.lcd_hold ||
+       (!appData.flags.rtc_lcd_update && !appData.flags.adc_lcd_update))
+    {
+        return;
+    }
+
+    appData.flags.rtc_lcd_update = 0;
+    appData.flags.adc_lcd_update = 0;
+
+    // Row 0: "Time    hh:mm:ss" straight from the RTCC BCD registers
+    time.bcdFormat = true;
+    BSP_RTCC_TimeGet(&time);
+
+    for(i = 0; i < 8; i++)
+    {
+        line[i] = appTimeLabel[i];
+    }
+    FORMAT_Bcd2(&line[8], time.hour);
+    line[10] = ':';
+    FORMAT_Bcd2(&line[11], time.minute);
+    line[13] = ':';
+    FORMAT_Bcd2(&line[14], time.second);
+    PRINT_String(line, APP_LCD_COLUMNS);
+
+    // Row 1: "3.300V    -12.5C" potentiometer volts and board temperature
+    for(i = 0; i < APP_LCD_COLUMNS; i++)
+    {
+        line[i] = ' ';
+    }
+    FORMAT_Fixed(&line[0], FORMAT_CountsToMillivolts(appData.adcCounts), 4, 3);
+    line[5] = 'V';
+
+    temperature = FORMAT_MillivoltsToDeciCelsius(FORMAT_CountsToMillivolts(appData.temperatureCounts));
+    FORMAT_Fixed(&line[10], (temperature < 0) ? -temperature : temperature, 4, 1);
+    if(temperature < 0)
+    {
+        // sign goes in front of the first digit
+        for(i = 10; line[i] == ' '; i++)
+        {
+        }
+        line[i - 1] = '-';
+    }
+    line[15] = 'C';
+    PRINT_String(line, APP_LCD_COLUMNS);
+}
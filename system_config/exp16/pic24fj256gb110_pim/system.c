@@ -42,7 +42,9 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 // ****************************************************************************
 // ****************************************************************************
 #include <xc.h>
+#include <string.h>
 #include "app.h"
+#include "system.h"
 
 // CONFIG3
 #pragma config WPFP = WPFP511           // Write Protection Flash Page Segment Boundary (Highest Page (same as page 170))
@@ -78,16 +80,39 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 // ****************************************************************************
 
 void SOSC_Configuration(void);
+static void SYS_SecondTick(void);
 
-void __attribute__((__interrupt__, auto_psv)) _OscillatorFail(void);
-void __attribute__((__interrupt__, auto_psv)) _AddressError(void);
-void __attribute__((__interrupt__, auto_psv)) _StackError(void);
-void __attribute__((__interrupt__, auto_psv)) _MathError(void);
+void __attribute__((noreturn)) SYS_TrapCapture(uint16_t trap);
+static void SYS_StackPaint(void);
+static void SYS_PutString(const char *string);
+static void SYS_PutHex(uint32_t value, uint8_t digits);
+static void SYS_PutDecimal(uint32_t value);
 
-void __attribute__((__interrupt__, auto_psv)) _AltOscillatorFail(void);
-void __attribute__((__interrupt__, auto_psv)) _AltAddressError(void);
-void __attribute__((__interrupt__, auto_psv)) _AltStackError(void);
-void __attribute__((__interrupt__, auto_psv)) _AltMathError(void);
+/* Data RAM of the PIC24FJ256GB110 (16 KB) */
+#define SYS_RAM_START   0x0800
+#define SYS_RAM_END     0x4800
+
+#define SYS_FAULT_MAGIC 0xFA17
+
+/* Stack painting. The stack grows up from __SP_init to __SPLIM_init (both
+ * linker symbols); unused stack is filled with SYS_STACK_PAINT and the high
+ * water mark is the start of the first run of SYS_STACK_PAINT_RUN painted
+ * words, so a local that happens to hold the pattern is not mistaken for
+ * the end of the used area. */
+#define SYS_STACK_PAINT         0x5AA5
+#define SYS_STACK_PAINT_RUN     4
+
+extern uint16_t _SP_init;
+extern uint16_t _SPLIM_init;
+
+#define SYS_STACK_BASE          ((uint16_t *) &_SP_init)
+#define SYS_STACK_END           ((uint16_t *) &_SPLIM_init)
+
+/* Fault record and trap-time W15. Persistent variables are not touched by
+ * the C start-up code, so they survive the software reset issued by
+ * SYS_TrapCapture(). They are cleared after a power-on reset. */
+static SYS_FAULT_RECORD sysFault __attribute__((persistent));
+volatile uint16_t sysTrapStackPointer __attribute__((persistent));
 
 // ****************************************************************************
 // ****************************************************************************
@@ -95,6 +120,18 @@ void __attribute__((__interrupt__, auto_psv)) _AltMathError(void);
 // ****************************************************************************
 // ****************************************************************************
 
+/* Time loaded into the RTCC after a power-on reset (Monday 1 Nov 2021) */
+static BSP_RTCC_DATETIME defaultTime = {
+    .bcdFormat = false,
+    .year = 21,
+    .month = 11,
+    .day = 1,
+    .weekday = 1,
+    .hour = 0,
+    .minute = 0,
+    .second = 0
+};
+
 /*******************************************************************************
   Function:
     void SYS_Initialize ( void )
@@ -132,11 +169,61 @@ void __attribute__((__interrupt__, auto_psv)) _AltMathError(void);
     4.  Initialize the main (static) application, if present.
 
     The order in which services and modules are initialized and started may be
-    important.
+    important.  Here it is:
+
+    1.  Timestamp, so the rest of the boot can be timed
+    2.  All peripheral pin select mappings, in the one unlock window IOL1WAY
+        allows
+    3.  Latency-critical peripherals: the bit bang UART and 1 ms tick
+        (Timer 3 and Timer 2), UART1 and SPI1
+    4.  Stack painting for the high water mark (SYS_StackPaint())
+    5.  Long-latency work started in the background: the LCD power-up and
+        setup run from the 1 ms tick (LCD_IsReady())
+    6.  Everything else
+
+    Boot times for steps 3 and 6 are reported on UART1 (SYS_BootReport()).
 
  */
 
 void SYS_Initialize(void) {
+    /* Start the free running timestamp first so everything after it can
+     * be timed */
+    TIME_Initialize();
+
+    /* Persistent RAM holds garbage after power-up, keep the fault record
+     * only across warm resets */
+    if (RCONbits.POR) {
+        memset(&sysFault, 0, sizeof (sysFault));
+        RCONbits.POR = 0;
+    }
+
+    /* Peripheral pin select locks for good at the first relock (IOL1WAY),
+     * so every module maps its pins in this one unlock window */
+    __builtin_write_OSCCONL(OSCCON & 0xBF);
+    UART_PinsInitialize();
+    SPI_PinsInitialize();
+    __builtin_write_OSCCONL(OSCCON | 0x40);
+
+    /* Bit bang UART (Timer 3) and the 1 ms tick (Timer 2) first, so the
+     * unit can transmit as early as possible after a reset */
+    TIMER_SetConfiguration();
+
+    /* UART1 carries diagnostics (trace dumps, fault reports) */
+    UART_Initialize();
+
+    /* SPI1 transaction queue */
+    SPI_Initialize();
+    SYS_BootReport("io");
+
+    /* Paint the unused stack once the latency-critical peripherals are
+     * running; painting starts at the current W15, so the frames used so
+     * far are left alone */
+    SYS_StackPaint();
+
+    /* The LCD needs tens of milliseconds after power-up; let the tick run
+     * its setup while the rest of the board comes up */
+    LCD_InitializeStart();
+
     /* Enable LEDs*/
     LED_Enable(LED_D9);
     LED_Enable(LED_D10);
@@ -152,278 +239,467 @@ void SYS_Initialize(void) {
     /* Enable Switch S6 - button to the right of S3*/
     BUTTON_Enable(BUTTON_S6);
 
-    /* Configure Secondary Oscillator for Timer 1 to work as RTC counter*/
+    /* Configure Secondary Oscillator as the RTCC clock source*/
     SOSC_Configuration();
-}
 
-void SOSC_Configuration(void) {
-    char a, b, c, *p;
+    /* Run the application clock from the hardware RTCC. RTCEN survives all
+     * but power-on resets, so keep the running time after a warm reset. */
+    if (RCFGCALbits.RTCEN) {
+        BSP_RTCC_Initialize(NULL);
+    } else {
+        BSP_RTCC_Initialize(&defaultTime);
+    }
+    BSP_RTCC_AlarmHandlerSet(SYS_SecondTick);
 
-    a = 2;
-    b = 0x46;
-    c = 0x57;
-    p = (char *) &OSCCON;
+    /* Continuous scan of the potentiometer and temperature sensor */
+    ADC_Initialize();
 
-    asm volatile ("mov.b %1,[%0] \n"
-            "mov.b %2,[%0] \n"
-            "mov.b %3,[%0] \n" : /* no outputs */ : "r"(p), "r"(b), "r"(c),
-            "r"(a));
+    /* 25LC256 EEPROM on SPI1 */
+    EEPROM_Initialize();
+
+    /* Report a fault captured before the last reset */
+    SYS_FaultReport();
+
+    /* Trap on overflow past the stack budget, keeping the headroom above
+       it for the fault capture code */
+#if (SYS_STACK_LIMIT_BYTES == SYS_STACK_LIMIT_LINKER)
+    if (!SYS_StackLimitSet(SYS_StackSizeGet() - SYS_STACK_TRAP_HEADROOM)) {
+#else
+    if (!SYS_StackLimitSet(SYS_STACK_LIMIT_BYTES)) {
+#endif
+        SYS_PutString("STACK limit not set\r\n");
+    }
+
+    SYS_BootReport("ready");
 }
 
-// *****************************************************************************
-// *****************************************************************************
-// Section: Interrupt Handlers
-// *****************************************************************************
-// *****************************************************************************
+// ****************************************************************************
+// ****************************************************************************
+// Section: Stack Usage
+// ****************************************************************************
+// ****************************************************************************
 
 /*******************************************************************************
-
   Function:
-   void __attribute__((__interrupt__)) _T1Interrupt( void ))
+    static void SYS_StackPaint(void)
 
   Summary:
-    ISR routine for the T1 Interrupt.
+    Fills the unused stack with the paint pattern.
 
   Description:
-    This is the raw Interrupt Service Routine (ISR) for the Timer 3 interrupt.
-    This routine calls the Timer1's interrupt routine to service the
-    interrupt.
+    Paints from the current W15 up to the linker stack limit. Interrupts
+    that fire while painting complete before painting resumes, so their
+    frames are dead by the time they are overwritten.
 
   Precondition:
-    The Timer peripheral must have been initialized for Timer 3.
+    Called once from SYS_Initialize(), after the "io" boot report.
 
   Parameters:
     None.
 
   Returns:
     None.
-
-  Remarks:
-    This routine must not be "called" as a C-language function is called.  It
-    is "vectored" to by the processor when the interrupt occurs.
  */
-void __attribute__((__interrupt__, auto_psv)) _T1Interrupt(void) {
-    /* update seconds */
-    if (appData.seconds < 59) {
-        appData.seconds++;
-    }        /* update minutes */
-    else {
-        appData.seconds = 0x00;
-        if (appData.minutes < 59) {
-            appData.minutes++;
-        }            /* update hours */
-        else {
-            appData.minutes = 0x00;
-            if (appData.hours < 23) {
-                appData.hours++;
-            } else {
-                appData.hours = 0x00;
-            }
-        }
-    }
-
-    /* set flag to update LCD */
-    appData.rtc_lcd_update = 1;
+static void SYS_StackPaint(void) {
+    uint16_t *word;
 
-    /* Toggle LED at 1 Hz rate */
-    LED_Toggle(LED_D10);
+    __asm__ volatile ("mov w15, %0" : "=r" (word));
 
-    /* reset Timer 1 interrupt flag */
-    IFS0bits.T1IF = 0;
+    while (word < SYS_STACK_END) {
+        *word++ = SYS_STACK_PAINT;
+    }
 }
 
-// *****************************************************************************
-// *****************************************************************************
-// Section: Primary Exception Vector handlers
-// *****************************************************************************
-// *****************************************************************************
+/*******************************************************************************
+  Function:
+    uint16_t SYS_StackSizeGet(void)
 
-// *****************************************************************************
+  Summary:
+    Returns the stack size reserved by the linker, in bytes.
+ */
+uint16_t SYS_StackSizeGet(void) {
+    return (uint16_t) ((uint8_t *) SYS_STACK_END - (uint8_t *) SYS_STACK_BASE);
+}
 
-/*  void __attribute__((__interrupt__,auto_psv)) _OscillatorFail(void)
+/*******************************************************************************
+  Function:
+    uint16_t SYS_StackHighWaterGet(void)
 
   Summary:
-    Provides the required exception vector handlers for Oscillator trap
+    Returns the deepest stack usage seen since reset, in bytes.
 
   Description:
-   This routine is used if INTCON2bits.ALTIVT = 0 and it handles the oscillator
- trap.
+    Scans up from the bottom of the stack for the first run of painted
+    words. The cost is proportional to the stack used, not the stack
+    reserved.
 
-  Remarks:
-   All trap service routines in this file simply ensure that device
-   continuously executes code within the trap service routine. Users
-   may modify the basic framework provided here to suit to the needs
-   of their application.
+  Precondition:
+    SYS_Initialize() has been called.
+
+  Parameters:
+    None.
+
+  Returns:
+    Bytes used, SYS_StackSizeGet() if no painted area is left.
  */
+uint16_t SYS_StackHighWaterGet(void) {
+    uint16_t *word;
+    uint16_t *first = NULL;
+
+    for (word = SYS_STACK_BASE; word < SYS_STACK_END; word++) {
+        if (*word != SYS_STACK_PAINT) {
+            first = NULL;
+            continue;
+        }
 
-void __attribute__((__interrupt__, auto_psv)) _OscillatorFail(void) {
-    INTCON1bits.OSCFAIL = 0; //Clear the trap flag
-    while (1);
-}
+        if (first == NULL) {
+            first = word;
+        }
 
-// *****************************************************************************
+        if ((word - first) == (SYS_STACK_PAINT_RUN - 1)) {
+            return (uint16_t) ((uint8_t *) first - (uint8_t *) SYS_STACK_BASE);
+        }
+    }
+
+    return SYS_StackSizeGet();
+}
 
-/*  void __attribute__((__interrupt__,auto_psv)) _AddressError(void)
+/*******************************************************************************
+  Function:
+    bool SYS_StackLimitSet(uint16_t bytes)
 
   Summary:
-    Provides the required exception vector handlers for Address Error trap
+    Programs SPLIM so that the stack may use at most bytes.
 
   Description:
-   This routine is used if INTCON2bits.ALTIVT = 0 and it handles the address
- error trap.
+    Growing the stack past the limit raises a stack error trap, which is
+    captured by SYS_TrapCapture(). The area between the new limit and the
+    linker limit is left for the capture code.
 
-  Remarks:
-   All trap service routines in this file simply ensure that device
-   continuously executes code within the trap service routine. Users
-   may modify the basic framework provided here to suit to the needs
-   of their application.
- */
+  Precondition:
+    SYS_Initialize() has been called.
 
-void __attribute__((__interrupt__, auto_psv)) _AddressError(void) {
-    INTCON1bits.ADDRERR = 0; //Clear the trap flag
-    while (1);
-}
+  Parameters:
+    bytes - stack budget from the bottom of the stack
 
-// *****************************************************************************
+  Returns:
+    false if bytes does not cover the usage seen so far or leaves less
+    than SYS_STACK_TRAP_HEADROOM for the trap handler, true otherwise.
+ */
+bool SYS_StackLimitSet(uint16_t bytes) {
+    bytes &= ~1;
 
-/*  void __attribute__((__interrupt__,auto_psv)) _StackError(void))
+    if ((bytes <= SYS_StackHighWaterGet()) ||
+            ((uint32_t) bytes + SYS_STACK_TRAP_HEADROOM > SYS_StackSizeGet())) {
+        return false;
+    }
 
-  Summary:
-    Provides the required exception vector handlers for Stack Error trap
+    SPLIM = (uint16_t) ((uint8_t *) SYS_STACK_BASE + bytes);
+    Nop(); /* W15 must not be used indirectly right after an SPLIM write */
 
-  Description:
-   This routine is used if INTCON2bits.ALTIVT = 0 and it handles the stack
- error trap.
+    return true;
+}
 
-  Remarks:
-   All trap service routines in this file simply ensure that device
-   continuously executes code within the trap service routine. Users
-   may modify the basic framework provided here to suit to the needs
-   of their application.
- */
+void SOSC_Configuration(void) {
+    char a, b, c, *p;
 
-void __attribute__((__interrupt__, auto_psv)) _StackError(void) {
-    INTCON1bits.STKERR = 0; //Clear the trap flag
-    while (1);
+    a = 2;
+    b = 0x46;
+    c = 0x57;
+    p = (char *) &OSCCON;
+
+    asm volatile ("mov.b %1,[%0] \n"
+            "mov.b %2,[%0] \n"
+            "mov.b %3,[%0] \n" : /* no outputs */ : "r"(p), "r"(b), "r"(c),
+            "r"(a));
 }
 
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interrupt Handlers
+// *****************************************************************************
 // *****************************************************************************
 
-/*  void __attribute__((__interrupt__,auto_psv)) _MathError(void))
+/*******************************************************************************
+
+  Function:
+   static void SYS_SecondTick( void )
 
   Summary:
-    Provides the required exception vector handlers for Math Error trap
+    Once a second application event.
 
   Description:
-   This routine is used if INTCON2bits.ALTIVT = 0 and it handles the math
- error trap.
+    Called from the RTCC alarm interrupt after the cached time has been
+    refreshed, so the application reads the new time through
+    BSP_RTCC_TimeGet().
+
+  Precondition:
+    BSP_RTCC_Initialize() has been called.
+
+  Parameters:
+    None.
+
+  Returns:
+    None.
 
   Remarks:
-   All trap service routines in this file simply ensure that device
-   continuously executes code within the trap service routine. Users
-   may modify the basic framework provided here to suit to the needs
-   of their application.
+    Runs in interrupt context.
  */
+static void SYS_SecondTick(void) {
+    BSP_RTCC_DATETIME now = {.bcdFormat = true};
 
-void __attribute__((__interrupt__, auto_psv)) _MathError(void) {
-    INTCON1bits.MATHERR = 0; //Clear the trap flag
-    while (1);
+    BSP_RTCC_TimeGet(&now);
+    TRACE_Event(TRACE_EVENT_RTCC_SECOND, ((uint16_t) now.minute << 8) | now.second);
+
+    /* set flag to update LCD */
+    appData.flags.rtc_lcd_update = 1;
+
+    /* Toggle LED at 1 Hz rate */
+    LED_Toggle(LED_D10);
 }
 
 // *****************************************************************************
 // *****************************************************************************
-// Section: Alternate Exception Vector handlers
-// *****************************************************************************
+// Section: Fault Capture
 // *****************************************************************************
-
 // *****************************************************************************
 
-/*  void __attribute__((__interrupt__,auto_psv)) _AltOscillatorFail(void)
+/*  Trap vectors
 
   Summary:
-    Provides the required exception vector handlers for Oscillator trap
+    Provides the exception vector handlers for the oscillator, address,
+    stack and math error traps on both the primary (INTCON2bits.ALTIVT = 0)
+    and the alternate (INTCON2bits.ALTIVT = 1) vector tables.
 
   Description:
-   This routine is used if INTCON2bits.ALTIVT = 1 and it handles the oscillator
- trap.
+    Each vector is a short assembly stub so that W15 can be captured before
+    any compiler generated prologue moves it. The stub saves W15, restores
+    SPLIM to the linker default so the capture routine has stack headroom
+    even after a stack error, loads the trap type into W0 and jumps to
+    SYS_TrapCapture(). That routine copies the stacked PC, SR and a short
+    stack snapshot into a persistent RAM record and issues a software
+    reset; SYS_FaultReport() prints the record on the next boot.
 
   Remarks:
-   All trap service routines in this file simply ensure that device
-   continuously executes code within the trap service routine. Users
-   may modify the basic framework provided here to suit to the needs
-   of their application.
+    The handlers never return, so the interrupted context does not need to
+    be preserved.
  */
+#define SYS_STRINGIFY(x)    #x
+#define SYS_XSTRINGIFY(x)   SYS_STRINGIFY(x)
+
+#define SYS_TRAP_VECTOR(name, trap)                             \
+    __asm__ (".pushsection .text\n"                             \
+             ".global __" #name "\n"                            \
+             "__" #name ":\n"                                   \
+             "    mov #_sysTrapStackPointer, w0\n"              \
+             "    mov w15, [w0]\n"                              \
+             "    mov #__SPLIM_init, w0\n"                      \
+             "    mov w0, _SPLIM\n"                             \
+             "    nop\n"                                        \
+             "    mov #" SYS_XSTRINGIFY(trap) ", w0\n"          \
+             "    goto _SYS_TrapCapture\n"                      \
+             ".popsection\n")
+
+SYS_TRAP_VECTOR(OscillatorFail, SYS_TRAP_OSCILLATOR_FAIL);
+SYS_TRAP_VECTOR(AddressError, SYS_TRAP_ADDRESS_ERROR);
+SYS_TRAP_VECTOR(StackError, SYS_TRAP_STACK_ERROR);
+SYS_TRAP_VECTOR(MathError, SYS_TRAP_MATH_ERROR);
+
+SYS_TRAP_VECTOR(AltOscillatorFail, (SYS_TRAP_OSCILLATOR_FAIL | SYS_TRAP_ALTERNATE));
+SYS_TRAP_VECTOR(AltAddressError, (SYS_TRAP_ADDRESS_ERROR | SYS_TRAP_ALTERNATE));
+SYS_TRAP_VECTOR(AltStackError, (SYS_TRAP_STACK_ERROR | SYS_TRAP_ALTERNATE));
+SYS_TRAP_VECTOR(AltMathError, (SYS_TRAP_MATH_ERROR | SYS_TRAP_ALTERNATE));
 
-void __attribute__((__interrupt__, auto_psv)) _AltOscillatorFail(void) {
-    INTCON1bits.OSCFAIL = 0;
-    while (1);
-}
-
-// *****************************************************************************
-
-/*  void __attribute__((__interrupt__,auto_psv)) _AltAddressError(void)
+/*******************************************************************************
+  Function:
+    void SYS_TrapCapture(uint16_t trap)
 
   Summary:
-    Provides the required exception vector handlers for Address Error trap
+    Records a trap into the persistent fault record and resets the device.
 
   Description:
-   This routine is used if INTCON2bits.ALTIVT = 1 and it handles the address
- error trap.
+    Entered from the trap vector stubs with the trap type in W0 and W15 at
+    trap entry in sysTrapStackPointer. The trap pushed PC<15:0> followed by
+    SR<7:0>:IPL3:PC<22:16>, so those are the two words just below the saved
+    W15. The words below them belong to the interrupted code.
 
-  Remarks:
-   All trap service routines in this file simply ensure that device
-   continuously executes code within the trap service routine. Users
-   may modify the basic framework provided here to suit to the needs
-   of their application.
+  Precondition:
+    Only called from the trap vector stubs.
+
+  Parameters:
+    trap - SYS_TRAP_xxx type, with SYS_TRAP_ALTERNATE for the alternate
+           vector table.
+
+  Returns:
+    Does not return.
  */
+void __attribute__((noreturn)) SYS_TrapCapture(uint16_t trap) {
+    uint16_t sp = sysTrapStackPointer;
+    uint16_t *frame = (uint16_t *) sp;
+    uint16_t i;
+
+    sysFault.trap = trap;
+    sysFault.sp = sp;
+    sysFault.intcon1 = INTCON1;
+    sysFault.pc = 0;
+    sysFault.sr = 0;
+
+    /* only trust the stack pointer if the frame and snapshot are in RAM */
+    if (((sp & 1) == 0) &&
+            (sp >= SYS_RAM_START + (2 + SYS_FAULT_STACK_WORDS) * sizeof (uint16_t)) &&
+            (sp <= SYS_RAM_END)) {
+        sysFault.pc = ((uint32_t) (frame[-1] & 0x007F) << 16) | frame[-2];
+        sysFault.sr = frame[-1] >> 8;
+
+        for (i = 0; i < SYS_FAULT_STACK_WORDS; i++) {
+            sysFault.stack[i] = frame[i - 2 - SYS_FAULT_STACK_WORDS];
+        }
+    }
 
-void __attribute__((__interrupt__, auto_psv)) _AltAddressError(void) {
-    INTCON1bits.ADDRERR = 0;
+    sysFault.count++;
+    sysFault.magic = SYS_FAULT_MAGIC;
+
+    __asm__ volatile ("reset");
     while (1);
 }
 
-// *****************************************************************************
+/*******************************************************************************
+  Function:
+    bool SYS_FaultGet(SYS_FAULT_RECORD *record)
+
+  Summary:
+    Returns the fault recorded before the last reset, if any.
+
+  Precondition:
+    SYS_Initialize() has been called.
+
+  Parameters:
+    record - receives a copy of the fault record
 
-/*  void __attribute__((__interrupt__,auto_psv)) _AltStackError(void))
+  Returns:
+    true if a fault was recorded since it was last cleared.
+ */
+bool SYS_FaultGet(SYS_FAULT_RECORD *record) {
+    *record = sysFault;
+    return (sysFault.magic == SYS_FAULT_MAGIC);
+}
+
+/*******************************************************************************
+  Function:
+    void SYS_FaultReport(void)
 
   Summary:
-    Provides the required exception vector handlers for Stack Error trap
+    Prints a pending fault record over UART1 and marks it reported.
 
   Description:
-   This routine is used if INTCON2bits.ALTIVT = 1 and it handles the stack
- error trap.
+    Output is a single line, for example:
+    FAULT 2 trap=0002 pc=0004A2 sp=0A1C sr=00 intcon1=0008 stack=...
 
-  Remarks:
-   All trap service routines in this file simply ensure that device
-   continuously executes code within the trap service routine. Users
-   may modify the basic framework provided here to suit to the needs
-   of their application.
+  Precondition:
+    UART_Initialize() has been called.
+
+  Parameters:
+    None.
+
+  Returns:
+    None.
  */
+void SYS_FaultReport(void) {
+    uint16_t i;
 
-void __attribute__((__interrupt__, auto_psv)) _AltStackError(void) {
-    INTCON1bits.STKERR = 0;
-    while (1);
-}
+    if (sysFault.magic != SYS_FAULT_MAGIC) {
+        return;
+    }
 
-// *****************************************************************************
+    SYS_PutString("FAULT ");
+    SYS_PutHex(sysFault.count, 4);
+    SYS_PutString(" trap=");
+    SYS_PutHex(sysFault.trap, 4);
+    SYS_PutString(" pc=");
+    SYS_PutHex(sysFault.pc, 6);
+    SYS_PutString(" sp=");
+    SYS_PutHex(sysFault.sp, 4);
+    SYS_PutString(" sr=");
+    SYS_PutHex(sysFault.sr, 2);
+    SYS_PutString(" intcon1=");
+    SYS_PutHex(sysFault.intcon1, 4);
+    SYS_PutString(" stack=");
+    for (i = 0; i < SYS_FAULT_STACK_WORDS; i++) {
+        SYS_PutHex(sysFault.stack[i], 4);
+        UART_PutChar(' ');
+    }
+    SYS_PutString("\r\n");
+
+    sysFault.magic = 0;
+}
 
-/*  void __attribute__((__interrupt__,auto_psv)) _AltMathError(void))
+/*******************************************************************************
+  Function:
+    void SYS_BootReport(const char *stage)
 
   Summary:
-    Provides the required exception vector handlers for Math Error trap
+    Prints the time since TIME_Initialize() over UART1.
 
   Description:
-   This routine is used if INTCON2bits.ALTIVT = 1 and it handles the math
- error trap.
+    Output is a single line, for example:
+    BOOT io 420us
 
-  Remarks:
-   All trap service routines in this file simply ensure that device
-   continuously executes code within the trap service routine. Users
-   may modify the basic framework provided here to suit to the needs
-   of their application.
+    SYS_Initialize() reports "io" once the latency-critical peripherals are
+    up and "ready" when it returns; the application reports later stages
+    (such as the LCD finishing its background initialization) the same way.
+
+  Precondition:
+    UART_Initialize() has been called.
+
+  Parameters:
+    stage - name of the boot stage reached
+
+  Returns:
+    None.
  */
+void SYS_BootReport(const char *stage) {
+    uint32_t microseconds = TIME_TicksToMicroseconds(TIME_NowTicks());
+
+    SYS_PutString("BOOT ");
+    SYS_PutString(stage);
+    UART_PutChar(' ');
+    SYS_PutDecimal(microseconds);
+    SYS_PutString("us\r\n");
+}
 
-void __attribute__((__interrupt__, auto_psv)) _AltMathError(void) {
-    INTCON1bits.MATHERR = 0;
-    while (1);
+static void SYS_PutString(const char *string) {
+    while (*string) {
+        UART_PutChar(*string++);
+    }
+}
+
+static void SYS_PutHex(uint32_t value, uint8_t digits) {
+    while (digits--) {
+        UART_PutChar("0123456789ABCDEF"[(value >> (digits * 4)) & 0x0F]);
+    }
+}
+
+static void SYS_PutDecimal(uint32_t value) {
+    static const uint32_t powers[] = {
+        1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+        10000UL, 1000UL, 100UL, 10UL, 1UL
+    };
+    const uint8_t count = sizeof (powers) / sizeof (powers[0]);
+    uint8_t i;
+    char digit;
+    bool leading = true;
+
+    /* Repeated subtraction, as in print_lcd.c, keeps the software divide
+     * out of the boot path */
+    for (i = 0; i < count; i++) {
+        digit = '0';
+        while (value >= powers[i]) {
+            value -= powers[i];
+            digit++;
+        }
+        if ((digit != '0') || !leading || (i == count - 1)) {
+            UART_PutChar(digit);
+            leading = false;
+        }
+    }
 }
@@ -0,0 +1,74 @@
+/*******************************************************************************
+ System Definitions File
+
+  File Name:
+    system.h
+
+  Summary:
+    System level definitions for the Explorer 16 PIC24FJ256GB110 PIM.
+
+  Description:
+    This file contains the clock definitions shared by the board support
+    modules. The oscillator configuration in system.c runs the 8 MHz XT
+    primary oscillator without the PLL, so FCY = FOSC / 2 = 4 MHz.
+ *******************************************************************************/
+
+#ifndef SYSTEM_H
+#define SYSTEM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Instruction cycle / peripheral clock (FCY) in Hz */
+#define SYSTEM_PERIPHERAL_CLOCK     4000000UL
+
+/* Instruction cycles per microsecond */
+#define SYSTEM_CYCLES_PER_MICRO_SECOND  (SYSTEM_PERIPHERAL_CLOCK / 1000000UL)
+
+/* Trap types stored in SYS_FAULT_RECORD.trap */
+#define SYS_TRAP_OSCILLATOR_FAIL    1
+#define SYS_TRAP_ADDRESS_ERROR      2
+#define SYS_TRAP_STACK_ERROR        3
+#define SYS_TRAP_MATH_ERROR         4
+#define SYS_TRAP_ALTERNATE          0x80    // taken through the alternate vector table
+
+#define SYS_FAULT_STACK_WORDS       8
+
+/* Fault captured by a trap handler, kept in persistent RAM across the
+   software reset that follows the trap */
+typedef struct
+{
+    uint16_t magic;
+    uint16_t trap;                          // SYS_TRAP_xxx
+    uint32_t pc;                            // return address stacked by the trap
+    uint16_t sp;                            // W15 on trap entry
+    uint16_t sr;                            // SR<7:0> stacked by the trap
+    uint16_t intcon1;                       // trap flags
+    uint16_t stack[SYS_FAULT_STACK_WORDS];  // interrupted stack, oldest word first
+    uint16_t count;                         // faults since power-on
+} SYS_FAULT_RECORD;
+
+bool SYS_FaultGet(SYS_FAULT_RECORD *record);
+void SYS_FaultReport(void);
+
+/* Boot time since TIME_Initialize(), printed as "BOOT <stage> <n>us" */
+void SYS_BootReport(const char *stage);
+
+/* Stack limit applied by SYS_Initialize(), in bytes from the bottom of the
+   stack; an overflow past it raises a stack error trap that is captured as
+   a fault. SYS_STACK_LIMIT_LINKER takes the stack reserved by the linker
+   (__SP_init to __SPLIM_init) less SYS_STACK_TRAP_HEADROOM. A build that
+   has measured its high water mark on the target ("stack" command) can
+   set that plus a margin instead, to trap a runaway sooner. */
+#define SYS_STACK_LIMIT_LINKER      0
+#define SYS_STACK_LIMIT_BYTES       SYS_STACK_LIMIT_LINKER
+
+/* Stack kept between SYS_STACK_LIMIT_BYTES and the linker limit for the
+   fault capture code that runs after a stack error */
+#define SYS_STACK_TRAP_HEADROOM     64
+
+uint16_t SYS_StackSizeGet(void);
+uint16_t SYS_StackHighWaterGet(void);
+bool SYS_StackLimitSet(uint16_t bytes);
+
+#endif //SYSTEM_H
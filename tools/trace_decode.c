@@ -0,0 +1,161 @@
+/*
+ * File:   trace_decode.c
+ *
+ * Host side decoder for the binary dump produced by TRACE_Dump() (see
+ * bsp/exp16/pic24fj256gb110_pim/trace.h for the format). Reads a capture
+ * of the UART1 byte stream and prints one line per record with absolute
+ * and delta times in microseconds.
+ *
+ * Build:  cc -std=c99 -O2 -o trace_decode tools/trace_decode.c
+ * Usage:  trace_decode capture.bin     (or read from stdin)
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_HEADER_SIZE   10
+#define TRACE_RECORD_SIZE   8
+#define TRACE_DUMP_VERSION  1
+
+/* Must match TRACE_EVENT in trace.h */
+static const char *eventNames[] =
+{
+    "NONE",
+    "UART_SIM_START",
+    "UART_SIM_END",
+    "SPI_WORD_DONE",
+    "RTCC_SECOND",
+    "ADC_BATCH",
+};
+
+static uint16_t Read16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t Read32(const uint8_t *p)
+{
+    return (uint32_t)Read16(p) | ((uint32_t)Read16(p + 2) << 16);
+}
+
+static void PrintEvent(uint16_t id)
+{
+    if (id < sizeof(eventNames) / sizeof(eventNames[0]))
+    {
+        printf("%-16s", eventNames[id]);
+    }
+    else if (id >= 0x80)
+    {
+        printf("USER+%-11u", (unsigned)(id - 0x80));
+    }
+    else
+    {
+        printf("0x%04X          ", (unsigned)id);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    FILE *input = stdin;
+    uint8_t *data = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+    size_t start;
+    size_t i;
+    uint16_t count, ticksPerMicrosecond, written, checksum = 0;
+    uint32_t first = 0, previous = 0;
+
+    if (argc > 1 && (input = fopen(argv[1], "rb")) == NULL)
+    {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    for (;;)
+    {
+        if (size == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 4096;
+            data = realloc(data, capacity);
+            if (data == NULL)
+            {
+                fprintf(stderr, "out of memory\n");
+                return EXIT_FAILURE;
+            }
+        }
+        size_t n = fread(data + size, 1, capacity - size, input);
+        if (n == 0)
+        {
+            break;
+        }
+        size += n;
+    }
+
+    /* Skip anything captured before the dump started */
+    for (start = 0; start + TRACE_HEADER_SIZE <= size; start++)
+    {
+        if (memcmp(data + start, "TRC", 3) == 0 && data[start + 3] == TRACE_DUMP_VERSION)
+        {
+            break;
+        }
+    }
+    if (start + TRACE_HEADER_SIZE > size)
+    {
+        fprintf(stderr, "no trace dump found\n");
+        return EXIT_FAILURE;
+    }
+
+    count = Read16(data + start + 4);
+    ticksPerMicrosecond = Read16(data + start + 6);
+    written = Read16(data + start + 8);
+
+    size_t end = start + TRACE_HEADER_SIZE + (size_t)count * TRACE_RECORD_SIZE;
+    if (end + 2 > size || ticksPerMicrosecond == 0)
+    {
+        fprintf(stderr, "truncated dump: %u records announced\n", (unsigned)count);
+        return EXIT_FAILURE;
+    }
+    for (i = start; i < end; i++)
+    {
+        checksum = (uint16_t)(checksum + data[i]);
+    }
+    if (checksum != Read16(data + end))
+    {
+        fprintf(stderr, "checksum mismatch (0x%04X != 0x%04X)\n", (unsigned)checksum, (unsigned)Read16(data + end));
+        return EXIT_FAILURE;
+    }
+
+    printf("%u records (%u written, %u ticks/us)\n", (unsigned)count, (unsigned)written, (unsigned)ticksPerMicrosecond);
+    printf("%5s %12s %10s  %-16s %s\n", "#", "time(us)", "delta(us)", "event", "arg");
+
+    for (i = 0; i < count; i++)
+    {
+        const uint8_t *record = data + start + TRACE_HEADER_SIZE + i * TRACE_RECORD_SIZE;
+        uint16_t id = Read16(record);
+        uint16_t arg = Read16(record + 2);
+        uint32_t timestamp = Read32(record + 4);
+
+        if (i == 0)
+        {
+            first = previous = timestamp;
+        }
+
+        /* unsigned differences stay correct across a counter wrap */
+        printf("%5u %12.2f %10.2f  ", (unsigned)i,
+               (double)(uint32_t)(timestamp - first) / ticksPerMicrosecond,
+               (double)(uint32_t)(timestamp - previous) / ticksPerMicrosecond);
+        PrintEvent(id);
+        printf(" 0x%04X\n", (unsigned)arg);
+
+        previous = timestamp;
+    }
+
+    free(data);
+    if (input != stdin)
+    {
+        fclose(input);
+    }
+    return EXIT_SUCCESS;
+}